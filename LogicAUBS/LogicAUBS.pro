@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui webkitwidgets
+QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -12,16 +12,17 @@ TARGET = LogicAUBS
 TEMPLATE = app
 
 
+include(core.pri)
+
 SOURCES += main.cpp\
         mainwindow.cpp \
     proofwindow.cpp \
-    proof.cpp
+    proofmodel.cpp \
+    verificationpool.cpp
 
 HEADERS  += mainwindow.h \
     proofwindow.h \
-    proof.h
+    proofmodel.h \
+    verificationpool.h
 
 FORMS    += mainwindow.ui
-
-RESOURCES += \
-    res.qrc
@@ -0,0 +1,369 @@
+#include "bdd.h"
+
+#include <QSet>
+
+/* Level of the terminals, below every variable: */
+#define TERMINAL_LEVEL 0x7FFFFFFF
+/* Level marking the nodes of the free list: */
+#define FREE_LEVEL (-1)
+
+static inline uint nodeHash(int level, int low, int high)
+{
+    return uint(level) * 12582917u + uint(low) * 4256249u + uint(high) * 741457u;
+}
+
+BddManager::BddManager(int maxNodes, int cacheBits) : freeHead(-1), maxNodes(qMax(maxNodes, 16)), liveNodes(2)
+{
+    Node terminal;
+    terminal.level = TERMINAL_LEVEL;
+    terminal.low = terminal.high = terminal.next = -1;
+    terminal.refs = 1;
+    nodes.append(terminal);
+    nodes.append(terminal);
+    buckets.fill(-1, 1024);
+    CacheEntry empty;
+    empty.f = -1;
+    empty.g = empty.h = empty.result = 0;
+    cache.fill(empty, 1 << cacheBits);
+    stats.liveNodes = stats.peakNodes = 2;
+    stats.collections = 0;
+    stats.cacheLookups = stats.cacheHits = 0;
+}
+
+void BddManager::rehash(int size)
+{
+    buckets.fill(-1, size);
+    for (int n = 2; n < nodes.size(); ++n) {
+        if (nodes[n].level == FREE_LEVEL)
+            continue;
+        uint h = nodeHash(nodes[n].level, nodes[n].low, nodes[n].high) & (size - 1);
+        nodes[n].next = buckets[h];
+        buckets[h] = n;
+    }
+}
+
+int BddManager::makeNode(int level, int low, int high)
+{
+    if (low == high)
+        return low;
+    uint h = nodeHash(level, low, high) & (buckets.size() - 1);
+    for (int n = buckets[h]; n >= 0; n = nodes[n].next) {
+        const Node &node = nodes[n];
+        if ((node.level == level) && (node.low == low) && (node.high == high))
+            return n;
+    }
+    int n;
+    if (freeHead >= 0) {
+        n = freeHead;
+        freeHead = nodes[n].next;
+    } else if (nodes.size() < maxNodes) {
+        n = nodes.size();
+        Node fresh;
+        fresh.level = FREE_LEVEL;
+        nodes.append(fresh);
+        if (nodes.size() > buckets.size()) {
+            rehash(2 * buckets.size());
+            h = nodeHash(level, low, high) & (buckets.size() - 1);
+        }
+    } else {
+        return Overflow;
+    }
+    Node &node = nodes[n];
+    node.level = level;
+    node.low = low;
+    node.high = high;
+    node.refs = 0;
+    node.next = buckets[h];
+    buckets[h] = n;
+    stats.peakNodes = qMax(stats.peakNodes, ++liveNodes);
+    return n;
+}
+
+void BddManager::ref(int node)
+{
+    if (node > True)
+        ++nodes[node].refs;
+}
+
+void BddManager::release(int node)
+{
+    if (node > True)
+        --nodes[node].refs;
+}
+
+/* The recursion depth is bounded by the number of variables: */
+int BddManager::ite(int f, int g, int h)
+{
+    if ((f < 0) || (g < 0) || (h < 0))
+        return Overflow;
+    if (f == True)
+        return g;
+    if (f == False)
+        return h;
+    if (g == h)
+        return g;
+    if ((g == True) && (h == False))
+        return f;
+    CacheEntry &entry = cache[nodeHash(f, g, h) & (cache.size() - 1)];
+    ++stats.cacheLookups;
+    if ((entry.f == f) && (entry.g == g) && (entry.h == h)) {
+        ++stats.cacheHits;
+        return entry.result;
+    }
+    int top = qMin(nodes[f].level, qMin(nodes[g].level, nodes[h].level));
+    int f0 = f, f1 = f, g0 = g, g1 = g, h0 = h, h1 = h;
+    if (nodes[f].level == top) {
+        f0 = nodes[f].low;
+        f1 = nodes[f].high;
+    }
+    if (nodes[g].level == top) {
+        g0 = nodes[g].low;
+        g1 = nodes[g].high;
+    }
+    if (nodes[h].level == top) {
+        h0 = nodes[h].low;
+        h1 = nodes[h].high;
+    }
+    int low = ite(f0, g0, h0);
+    if (low < 0)
+        return Overflow;
+    int high = ite(f1, g1, h1);
+    if (high < 0)
+        return Overflow;
+    int result = makeNode(top, low, high);
+    if (result >= 0) {
+        entry.f = f;
+        entry.g = g;
+        entry.h = h;
+        entry.result = result;
+    }
+    return result;
+}
+
+int BddManager::bddNot(int f)
+{
+    return ite(f, False, True);
+}
+
+int BddManager::bddAnd(int f, int g)
+{
+    return ite(f, g, False);
+}
+
+int BddManager::bddOr(int f, int g)
+{
+    return ite(f, True, g);
+}
+
+int BddManager::bddImply(int f, int g)
+{
+    return ite(f, g, True);
+}
+
+int BddManager::bddEquiv(int f, int g)
+{
+    return ite(f, g, bddNot(g));
+}
+
+/* Gives the next levels to the new variables, in depth-first order: */
+void BddManager::orderVariables(const Expression *e)
+{
+    QSet<const Expression *> visited;
+    QVector<const Expression *> stack;
+    stack.append(e);
+    while (!stack.isEmpty()) {
+        const Expression *top = stack.takeLast();
+        if (visited.contains(top) || converted.contains(top))
+            continue;
+        visited.insert(top);
+        if (top->getKind() == Expression::Variable) {
+            const QString &name = static_cast<const ExprVar *>(top)->getName();
+            if (!levels.contains(name)) {
+                levels.insert(name, order.size());
+                order.append(name);
+            }
+            continue;
+        }
+        for (int i = top->getChildCount(); i-- > 0;)
+            stack.append(top->getChild(i));
+    }
+}
+
+int BddManager::convert(const Expression *e)
+{
+    /* Postorder without recursion, so that operands are converted first: */
+    QVector<const Expression *> stack;
+    stack.append(e);
+    while (!stack.isEmpty()) {
+        const Expression *top = stack.last();
+        if (converted.contains(top)) {
+            stack.removeLast();
+            continue;
+        }
+        int pending = stack.size();
+        for (int i = top->getChildCount(); i-- > 0;) {
+            if (!converted.contains(top->getChild(i)))
+                stack.append(top->getChild(i));
+        }
+        if (stack.size() > pending)
+            continue;
+        stack.removeLast();
+        int a = (top->getChildCount() > 0) ? converted.value(top->getChild(0)) : False;
+        int b = (top->getChildCount() > 1) ? converted.value(top->getChild(1)) : False;
+        int result = Overflow;
+        switch (top->getKind()) {
+        case Expression::Variable:
+            result = makeNode(levels.value(static_cast<const ExprVar *>(top)->getName()), False, True);
+            break;
+        case Expression::NOT:
+            result = bddNot(a);
+            break;
+        case Expression::OR:
+            result = bddOr(a, b);
+            break;
+        case Expression::AND:
+            result = bddAnd(a, b);
+            break;
+        case Expression::Imply:
+            result = bddImply(a, b);
+            break;
+        case Expression::Equiv:
+            result = bddEquiv(a, b);
+            break;
+        }
+        if (result == Overflow)
+            return Overflow;
+        converted.insert(top, result);
+    }
+    return converted.value(e);
+}
+
+int BddManager::fromExpression(const Expression *e)
+{
+    if (liveNodes > maxNodes - maxNodes / 4)
+        collectGarbage();
+    if (converted.size() > maxNodes)
+        converted.clear();
+    orderVariables(e);
+    int result = convert(e);
+    if (result == Overflow) {
+        collectGarbage();
+        result = convert(e);
+    }
+    ref(result);
+    return result;
+}
+
+/* Keeps the nodes reachable from a referenced node, and forgets everything cached: */
+void BddManager::collectGarbage()
+{
+    ++stats.collections;
+    converted.clear();
+    for (int i = 0; i < cache.size(); ++i)
+        cache[i].f = -1;
+    QVector<bool> marked(nodes.size());
+    QVector<int> stack;
+    for (int n = 2; n < nodes.size(); ++n) {
+        if ((nodes[n].level != FREE_LEVEL) && (nodes[n].refs > 0))
+            stack.append(n);
+    }
+    while (!stack.isEmpty()) {
+        int n = stack.takeLast();
+        if ((n <= True) || marked[n])
+            continue;
+        marked[n] = true;
+        stack.append(nodes[n].low);
+        stack.append(nodes[n].high);
+    }
+    freeHead = -1;
+    liveNodes = 2;
+    for (int n = nodes.size() - 1; n > True; --n) {
+        if (marked[n]) {
+            ++liveNodes;
+        } else {
+            nodes[n].level = FREE_LEVEL;
+            nodes[n].next = freeHead;
+            freeHead = n;
+        }
+    }
+    rehash(buckets.size());
+}
+
+/* Returns the referenced conjunction of the formulas: */
+int BddManager::conjunction(const QList<const Expression *> &formulas)
+{
+    int result = True;
+    foreach (const Expression *formula, formulas) {
+        int f = fromExpression(formula);
+        int next = bddAnd(result, f);
+        ref(next);
+        release(result);
+        release(f);
+        result = next;
+        if (result == Overflow)
+            break;
+    }
+    return result;
+}
+
+BddManager::Result BddManager::equivalent(const Expression *e1, const Expression *e2)
+{
+    int a = fromExpression(e1), b = fromExpression(e2);
+    Result result = ((a == Overflow) || (b == Overflow)) ? Unknown : ((a == b) ? Holds : Fails);
+    release(a);
+    release(b);
+    return result;
+}
+
+BddManager::Result BddManager::implies(const Expression *e1, const Expression *e2)
+{
+    int a = fromExpression(e1), b = fromExpression(e2);
+    int implication = bddImply(a, b);
+    release(a);
+    release(b);
+    if (implication == Overflow)
+        return Unknown;
+    return (implication == True) ? Holds : Fails;
+}
+
+/* Canonical form of a rule: the referenced conjunctions of its premises and of its conclusions. */
+bool BddManager::canonicalRule(const Rule &rule, int *premises, int *conclusions)
+{
+    *premises = conjunction(rule.getPremises());
+    *conclusions = conjunction(rule.getConclusions());
+    if ((*premises != Overflow) && (*conclusions != Overflow))
+        return true;
+    release(*premises);
+    release(*conclusions);
+    return false;
+}
+
+const QStringList &BddManager::getOrder() const
+{
+    return order;
+}
+
+int BddManager::getNodeCount(int f) const
+{
+    if (f < 0)
+        return 0;
+    QSet<int> visited;
+    QVector<int> stack;
+    stack.append(f);
+    while (!stack.isEmpty()) {
+        int n = stack.takeLast();
+        if (visited.contains(n))
+            continue;
+        visited.insert(n);
+        if (n > True)
+            stack << nodes[n].low << nodes[n].high;
+    }
+    return visited.size();
+}
+
+BddManager::Stats BddManager::getStats() const
+{
+    Stats result = stats;
+    result.liveNodes = liveNodes;
+    return result;
+}
@@ -0,0 +1,76 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+
+#include "proof.h"
+
+/*
+ * Reduced ordered binary decision diagrams. Nodes are identified by integers,
+ * and a node is unique for its function: within a manager, two formulas are
+ * equivalent exactly when they convert to the same node. Variables are ordered
+ * by first appearance in a depth-first walk of the converted formulas, which
+ * keeps the variables of a subformula close to each other.
+ * The number of nodes is bounded: fromExpression() collects the garbage when
+ * the nodes run short, keeping the referenced nodes only, and returns Overflow
+ * when a formula does not fit. The nodes it returns are referenced, and are to
+ * be released; other results are valid until the next collection.
+ */
+class BddManager
+{
+public:
+    enum Result { Holds, Fails, Unknown };
+    static const int False = 0, True = 1, Overflow = -1;
+    struct Stats
+    {
+        int liveNodes, peakNodes, collections;
+        qint64 cacheLookups, cacheHits;
+    };
+public:
+    BddManager(int maxNodes = 1 << 20, int cacheBits = 16);
+    int fromExpression(const Expression *e);
+    void ref(int node);
+    void release(int node);
+    int bddNot(int f);
+    int bddAnd(int f, int g);
+    int bddOr(int f, int g);
+    int bddImply(int f, int g);
+    int bddEquiv(int f, int g);
+    int ite(int f, int g, int h);
+    Result equivalent(const Expression *e1, const Expression *e2);
+    Result implies(const Expression *e1, const Expression *e2);
+    bool canonicalRule(const Rule &rule, int *premises, int *conclusions);
+    const QStringList &getOrder() const;
+    int getNodeCount(int f) const;
+    void collectGarbage();
+    Stats getStats() const;
+private:
+    struct Node
+    {
+        int level, low, high, next, refs;
+    };
+    struct CacheEntry
+    {
+        int f, g, h, result;
+    };
+private:
+    int makeNode(int level, int low, int high);
+    int convert(const Expression *e);
+    int conjunction(const QList<const Expression *> &formulas);
+    void orderVariables(const Expression *e);
+    void rehash(int size);
+private:
+    QVector<Node> nodes;
+    QVector<int> buckets;
+    int freeHead, maxNodes, liveNodes;
+    QVector<CacheEntry> cache;
+    QHash<const Expression *, int> converted;
+    QStringList order;
+    QHash<QString, int> levels;
+    Stats stats;
+};
+
+#endif // BDD_H
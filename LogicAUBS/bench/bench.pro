@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Micro-benchmarks of the proof core
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = aubs-bench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += main.cpp \
+    meter.cpp
+
+HEADERS += meter.h
@@ -0,0 +1,600 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <cstdio>
+
+#include "proof.h"
+#include "evaluator.h"
+#include "validity.h"
+#include "bdd.h"
+#include "ruleindex.h"
+#include "meter.h"
+
+/* Small deterministic generator, so that runs are comparable: */
+class Random
+{
+public:
+    Random(quint64 seed) : state(seed ? seed : 1) {}
+    uint next(uint bound)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return uint(state % bound);
+    }
+private:
+    quint64 state;
+};
+
+static QString variableName(int k)
+{
+    QString name;
+    do {
+        name += QChar('a' + k % 26);
+        k /= 26;
+    } while (k);
+    return name;
+}
+
+static QString randomVariable(Random &random, int variables)
+{
+    return variableName(random.next(variables));
+}
+
+static QString randomFormula(Random &random, int depth, int variables)
+{
+    if (!depth || !random.next(5))
+        return randomVariable(random, variables);
+    switch (random.next(5)) {
+    case 0:
+        return QStringLiteral("~(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")");
+    case 1:
+        return QStringLiteral("(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")&(")
+                + randomFormula(random, depth - 1, variables) + QStringLiteral(")");
+    case 2:
+        return QStringLiteral("(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")|(")
+                + randomFormula(random, depth - 1, variables) + QStringLiteral(")");
+    case 3:
+        return QStringLiteral("(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")>(")
+                + randomFormula(random, depth - 1, variables) + QStringLiteral(")");
+    default:
+        return QStringLiteral("(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")=(")
+                + randomFormula(random, depth - 1, variables) + QStringLiteral(")");
+    }
+}
+
+/* The recursive descent parser that Expression::fromStr() replaced, kept as a reference: */
+static const Expression *recursiveParse(const QString &str, int start, int maxLevel, int &end)
+{
+    if (maxLevel >= 2) {
+        const Expression *e1 = recursiveParse(str, start, maxLevel - 1, end);
+        if (!e1 || (end >= str.length()))
+            return e1;
+        QChar op = str[end];
+        Expression::Kind kind;
+        if ((maxLevel == 3) && ((op == '>') || (op == '=')))
+            kind = (op == '>') ? Expression::Imply : Expression::Equiv;
+        else if ((maxLevel == 2) && ((op == '|') || (op == '&')))
+            kind = (op == '|') ? Expression::OR : Expression::AND;
+        else
+            return e1;
+        const Expression *e2 = recursiveParse(str, ++end, maxLevel - 1, end);
+        return e2 ? ExprFactory::make(kind, e1, e2) : NULL;
+    }
+    if (start >= str.length())
+        return NULL;
+    if (maxLevel == 1) {
+        int mid = start;
+        while (str[mid] == '~') {
+            if (++mid >= str.length())
+                return NULL;
+        }
+        const Expression *result = recursiveParse(str, mid, 0, end);
+        for (; result && (start < mid); ++start)
+            result = ExprFactory::makeNOT(result);
+        return result;
+    }
+    if (str[start] == '(') {
+        const Expression *e = recursiveParse(str, start + 1, 3, end);
+        if (!e || (end >= str.length()) || (str[end] != ')'))
+            return NULL;
+        ++end;
+        return e;
+    }
+    end = start;
+    while ((end < str.length()) && str[end].isLetter())
+        ++end;
+    if (end == start)
+        return NULL;
+    return ExprFactory::makeVar(str.mid(start, end - start));
+}
+
+static QString toUnicodeNotation(QString formula)
+{
+    formula.replace('~', QChar(0x00AC));
+    formula.replace('|', QChar(0x2228));
+    formula.replace('&', QChar(0x2227));
+    formula.replace('>', QChar(0x2192));
+    formula.replace('=', QChar(0x2194));
+    return formula;
+}
+
+static void benchParse(int count, int depth, int variables, quint64 seed)
+{
+    Random random(seed);
+    QStringList formulas, unicodeFormulas;
+    qint64 chars = 0;
+    for (int i = 0; i < count; ++i) {
+        formulas.append(randomFormula(random, depth, variables));
+        unicodeFormulas.append(toUnicodeNotation(formulas.last()));
+        chars += formulas.last().length();
+    }
+    ExprFactory::Stats before = ExprFactory::getStats();
+    Meter timer;
+    timer.start();
+    foreach (const QString &formula, formulas)
+        Expression::fromStr(formula);
+    report("parse (new)", timer, count, chars);
+    ExprFactory::Stats after = ExprFactory::getStats();
+
+    /* Every node exists already; this measures the parser and the lookups alone: */
+    timer.start();
+    foreach (const QString &formula, formulas)
+        Expression::fromStr(formula);
+    report("parse (interned)", timer, count, chars);
+    timer.start();
+    foreach (const QString &formula, formulas) {
+        int end;
+        recursiveParse(formula, 0, 3, end);
+    }
+    report("parse (recursive)", timer, count, chars);
+    timer.start();
+    foreach (const QString &formula, unicodeFormulas)
+        Expression::fromStr(formula);
+    report("parse (unicode)", timer, count, chars);
+
+    int nodes = after.nodeCount - before.nodeCount;
+    printf("%-24s %12d nodes %10.1f bytes/node (%.1f with arena slack)\n", "expressions", nodes,
+           double(after.nodeBytes - before.nodeBytes) / qMax(nodes, 1),
+           double(after.arenaBytes - before.arenaBytes) / qMax(nodes, 1));
+
+    /* A single formula of several megabytes, as deep as there are formulas: */
+    QString big;
+    for (int i = 0; i < count; ++i)
+        big += QStringLiteral("(") + formulas[i] + ((i + 1 < count) ? QStringLiteral(")&(") : QStringLiteral(")"));
+    big += QString(count - 1, QChar(')'));
+    timer.start();
+    const Expression *e = Expression::fromStr(big);
+    report(e ? "parse (one formula)" : "parse (one formula) FAILED", timer, 1, big.length());
+}
+
+static void benchVariables(int count, int depth, int variables, quint64 seed)
+{
+    Random random(seed);
+    QList<const Expression *> formulas;
+    for (int i = 0; i < count; ++i)
+        formulas.append(Expression::fromStr(randomFormula(random, depth, variables)));
+    int total = 0;
+    Meter timer;
+    timer.start();
+    foreach (const Expression *e, formulas)
+        total += e->getVariableSet().count();
+    report("variables (set)", timer, count);
+    timer.start();
+    foreach (const Expression *e, formulas)
+        total -= e->getVariables().size();
+    report(total ? "variables (names) MISMATCH" : "variables (names)", timer, count);
+}
+
+static void benchAdapt(int count, int depth, int variables, quint64 seed)
+{
+    Random random(seed);
+    QList<Rule *> rules;
+    QList< QMap<QString, const Expression *> > renamings;
+    for (int i = 0; i < count; ++i) {
+        QList<const Expression *> premises, conclusions;
+        premises << Expression::fromStr(randomFormula(random, depth, 4)) << Expression::fromStr(randomFormula(random, depth, 4));
+        conclusions << Expression::fromStr(randomFormula(random, depth, 4));
+        rules.append(new Rule(premises, conclusions));
+        QMap<QString, const Expression *> renaming;
+        foreach (const QString &name, rules.last()->getInputVariables() | rules.last()->getOutputVariables())
+            renaming.insert(name, Expression::fromStr(randomFormula(random, depth / 2, variables)));
+        renamings.append(renaming);
+    }
+    Meter timer;
+    timer.start();
+    for (int i = 0; i < count; ++i)
+        delete rules[i]->adapt(renamings[i]);
+    report("adapt", timer, count);
+
+    /* Checking a step: its conclusion against the instance, built or not: */
+    QList<const Expression *> outputs;
+    for (int i = 0; i < count; ++i)
+        outputs.append(rules[i]->getConclusions().first()->replaceVariableNames(renamings[i]));
+    int failures = 0;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        Rule *instance = rules[i]->adapt(renamings[i]);
+        failures += (instance->getConclusions().first() != outputs[i]);
+        delete instance;
+    }
+    report("check step (adapt)", timer, count);
+    timer.start();
+    for (int i = 0; i < count; ++i)
+        failures += !Substitution(renamings[i]).maps(rules[i]->getConclusions().first(), outputs[i]);
+    report(failures ? "check step (match) FAILED" : "check step (match)", timer, count);
+    qDeleteAll(rules);
+}
+
+static void benchEvaluate(int depth, quint64 seed)
+{
+    Random random(seed);
+    for (int variables = 8; variables <= Evaluator::maxVariables; variables += 4) {
+        /* The conclusion follows from the premise, so that every assignment is visited: */
+        const Expression *all = ExprFactory::makeVar(randomVariable(random, 1));
+        for (int k = 1; k < variables; ++k)
+            all = ExprFactory::makeOR(ExprFactory::makeVar(variableName(k)), all);
+        const Expression *premise = ExprFactory::makeAND(Expression::fromStr(randomFormula(random, depth, variables)), all);
+        const Expression *conclusion = ExprFactory::makeOR(premise, Expression::fromStr(randomFormula(random, depth, variables)));
+        Evaluator evaluator(QList<const Expression *>() << premise << conclusion);
+        int runs = qMax(1, (1 << 20) >> variables);
+        Meter timer;
+        for (int simd = 0; simd <= int(Evaluator::hasSimd()); ++simd) {
+            timer.start();
+            for (int i = 0; i < runs; ++i)
+                evaluator.findCounterexample(QList<int>() << 0, 1, NULL, simd ? Evaluator::Auto : Evaluator::Scalar);
+            QString name = QStringLiteral("entails/%1v/%2i%3").arg(variables).arg(evaluator.getProgram().size()).arg(simd ? "/avx2" : "");
+            report(name, timer, runs);
+        }
+    }
+}
+
+static void benchEquivalent(int count, int depth, quint64 seed)
+{
+    Random random(seed);
+    QList<const Expression *> formulas;
+    for (int i = 0; i < 2 * count; ++i)
+        formulas.append(Expression::fromStr(randomFormula(random, depth, 16)));
+    BddManager manager;
+    int equivalent = 0;
+    Meter timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        if (manager.equivalent(formulas[2 * i], formulas[2 * i + 1]) == BddManager::Holds)
+            ++equivalent;
+    }
+    timer.stop();
+    BddManager::Stats stats = manager.getStats();
+    report("bdd equivalent", timer, count);
+    printf("%-24s %12d nodes %10d equivalent %9.1f%% cache hits\n", "bdd", stats.peakNodes, equivalent,
+           100.0 * stats.cacheHits / qMax(stats.cacheLookups, qint64(1)));
+}
+
+/* Lemma formulas are rarely a bare variable, which would match any goal: */
+static QString randomPattern(Random &random, int depth, int variables)
+{
+    static const char connectives[] = "&|>=";
+    return QStringLiteral("(") + randomFormula(random, depth - 1, variables) + QStringLiteral(")")
+            + QChar(connectives[random.next(4)]) + QStringLiteral("(") + randomFormula(random, depth - 1, variables)
+            + QStringLiteral(")");
+}
+
+static void benchIndex(int lemmas, int depth, quint64 seed)
+{
+    Random random(seed);
+    RuleIndex index;
+    index.insertBasicRules();
+    for (int i = 0; i < lemmas; ++i) {
+        QString rule = randomPattern(random, depth, 4) + QStringLiteral(", ") + randomPattern(random, depth, 4)
+                + QStringLiteral(" : ") + randomPattern(random, depth, 4);
+        index.insert(QStringLiteral("lemma%1.aubs").arg(i), QSharedPointer<Rule>(Rule::fromStr(rule)));
+    }
+    QList<const Expression *> goals;
+    for (int i = 0; i < 1000; ++i)
+        goals.append(Expression::fromStr(randomFormula(random, 2 * depth, 16)));
+    for (int side = RuleIndex::Premise; side <= RuleIndex::Conclusion; ++side) {
+        int matches = 0;
+        Meter timer;
+        timer.start();
+        foreach (const Expression *goal, goals)
+            matches += index.lookup(goal, RuleIndex::Side(side)).size();
+        timer.stop();
+        report((side == RuleIndex::Premise) ? "index premises" : "index conclusions", timer, goals.size());
+        printf("%-24s %12d rules %10d nodes %9.1f matches/op\n", "index", index.getRuleCount(), index.getNodeCount(),
+               double(matches) / goals.size());
+    }
+}
+
+/* A formula of the given number of nodes, the sizes of the operands being drawn at random: */
+static QString sizedFormula(Random &random, int nodes, int variables)
+{
+    if (nodes <= 1)
+        return randomVariable(random, variables);
+    if ((nodes == 2) || !random.next(5))
+        return QStringLiteral("~(") + sizedFormula(random, nodes - 1, variables) + QStringLiteral(")");
+    static const char connectives[] = "&|>=";
+    int left = 1 + random.next(nodes - 2);
+    return QStringLiteral("(") + sizedFormula(random, left, variables) + QStringLiteral(")")
+            + QChar(connectives[random.next(4)]) + QStringLiteral("(")
+            + sizedFormula(random, nodes - 1 - left, variables) + QStringLiteral(")");
+}
+
+/* A proof of p : p in the given number of steps, repeating p|v, (p|v)&p, p for fresh variables v: */
+static QSharedPointer<Rule> syntheticProof(int stepCount, int variables, QList<Step> &steps, QList<int> &stepIndexes)
+{
+    const Expression *p = ExprFactory::makeVar(QStringLiteral("p"));
+    steps.clear();
+    Step step;
+    step.indentation = 0;
+    step.clIndex = 0;
+    step.output = p;
+    step.rule = QStringLiteral("-");
+    steps.append(step);
+    int last = 0;
+    for (int k = 0; steps.size() < stepCount; ++k) {
+        const Expression *disjunction = ExprFactory::makeOR(p, ExprFactory::makeVar(variableName(k % variables)));
+        step.renaming.clear();
+        step.renaming.insert(QStringLiteral("X"), p);
+        step.renaming.insert(QStringLiteral("Y"), ExprFactory::makeVar(variableName(k % variables)));
+        step.rule = QStringLiteral(":IntroOr");
+        step.basicRule = IntroOrRule;
+        step.usedInputs = QList<int>() << 0;
+        step.clIndex = 0;
+        step.output = disjunction;
+        steps.append(step);
+        step.renaming.insert(QStringLiteral("X"), disjunction);
+        step.renaming.insert(QStringLiteral("Y"), p);
+        step.rule = QStringLiteral(":IntroAnd");
+        step.basicRule = IntroAndRule;
+        step.usedInputs = QList<int>() << (steps.size() - 1) << 0;
+        step.output = ExprFactory::makeAND(disjunction, p);
+        steps.append(step);
+        step.rule = QStringLiteral(":ElimAnd");
+        step.basicRule = ElimAndRule;
+        step.usedInputs = QList<int>() << (steps.size() - 1);
+        step.clIndex = 1;
+        step.output = p;
+        steps.append(step);
+        last = steps.size() - 1;
+    }
+    while (steps.size() > stepCount)
+        steps.removeLast();
+    stepIndexes = QList<int>() << ((last < stepCount) ? last : 0);
+    return QSharedPointer<Rule>(new Rule(QList<const Expression *>() << p, QList<const Expression *>() << p));
+}
+
+/* Variables of the scaling runs, few enough for their sets to be stored on the nodes: */
+#define SCALING_VARIABLES 64
+/* Formula nodes and proof steps handled by each scaling run, so that small sizes are repeated: */
+#define SCALING_FORMULA_NODES 1000000
+#define SCALING_PROOF_STEPS 100000
+
+/* Parsing, serialization, substitution, proof input and output and verification, from 10^2 to maxSize: */
+static void benchScaling(int maxSize, quint64 seed)
+{
+    Random random(seed);
+    QString textFile = QDir::temp().filePath(QStringLiteral("aubs-bench-%1.aubs").arg(QCoreApplication::applicationPid()));
+    QString binaryFile = textFile + QStringLiteral("b");
+    for (qint64 size = 100; size <= maxSize; size *= 10) {
+        int n = int(size);
+        int count = qMax(1, SCALING_FORMULA_NODES / n);
+        QStringList strings;
+        qint64 chars = 0;
+        for (int i = 0; i < count; ++i) {
+            strings.append(sizedFormula(random, n, SCALING_VARIABLES));
+            chars += strings.last().length();
+        }
+        QList<const Expression *> formulas;
+        Meter timer;
+        timer.start();
+        foreach (const QString &str, strings)
+            formulas.append(Expression::fromStr(str));
+        report(QStringLiteral("fromStr/%1").arg(n), timer, count, chars, n);
+        timer.start();
+        foreach (const Expression *e, formulas)
+            e->getStr();
+        report(QStringLiteral("getStr/%1").arg(n), timer, count, chars, n);
+        timer.start();
+        foreach (const Expression *e, formulas)
+            e->getStr();
+        report(QStringLiteral("getStr (cached)/%1").arg(n), timer, count, chars, n);
+        timer.start();
+        foreach (const Expression *e, formulas)
+            e->getVariables();
+        report(QStringLiteral("getVariables/%1").arg(n), timer, count, 0, n);
+
+        QList<Rule *> rules;
+        QMap<QString, const Expression *> renaming;
+        for (int k = 0; k < SCALING_VARIABLES; ++k)
+            renaming.insert(variableName(k), Expression::fromStr(randomFormula(random, 2, SCALING_VARIABLES)));
+        for (int i = 0; i < count; ++i)
+            rules.append(new Rule(QList<const Expression *>() << formulas[i], QList<const Expression *>() << formulas[(i + 1) % count]));
+        timer.start();
+        foreach (const Rule *rule, rules)
+            delete rule->adapt(renaming);
+        report(QStringLiteral("adapt/%1").arg(n), timer, count, 0, n);
+        qDeleteAll(rules);
+
+        /* Proofs are measured per proof, the steps being as many as the nodes above: */
+        int runs = qMax(1, SCALING_PROOF_STEPS / n);
+        QList<Step> steps;
+        QList<int> stepIndexes;
+        QSharedPointer<Rule> rule = syntheticProof(n, SCALING_VARIABLES, steps, stepIndexes);
+        bool correct = true;
+        timer.start();
+        for (int i = 0; i < runs; ++i) {
+            Proof verified(rule, steps, stepIndexes);
+            correct = correct && verified.isCorrect() && verified.isFinished();
+        }
+        timer.stop();
+        report(QStringLiteral(correct ? "verify/%1" : "verify/%1 FAILED").arg(n), timer, runs, 0, n);
+        Proof proof(rule, steps, stepIndexes);
+        timer.start();
+        for (int i = 0; i < runs; ++i)
+            proof.saveToFile(textFile);
+        timer.stop();
+        report(QStringLiteral("save/%1").arg(n), timer, runs, runs * QFileInfo(textFile).size(), n);
+        timer.start();
+        for (int i = 0; i < runs; ++i) {
+            Proof loaded(textFile, false);
+            correct = correct && (loaded.getStepCount() == n);
+        }
+        timer.stop();
+        report(QStringLiteral(correct ? "load/%1" : "load/%1 FAILED").arg(n), timer, runs, runs * QFileInfo(textFile).size(), n);
+        timer.start();
+        for (int i = 0; i < runs; ++i)
+            proof.saveToBinaryFile(binaryFile);
+        timer.stop();
+        report(QStringLiteral("save (binary)/%1").arg(n), timer, runs, runs * QFileInfo(binaryFile).size(), n);
+        timer.start();
+        for (int i = 0; i < runs; ++i) {
+            Proof loaded(binaryFile, false);
+            correct = correct && (loaded.getStepCount() == n);
+        }
+        timer.stop();
+        report(QStringLiteral(correct ? "load (binary)/%1" : "load (binary)/%1 FAILED").arg(n), timer, runs,
+               runs * QFileInfo(binaryFile).size(), n);
+        /* Verified as the steps are decoded into one Step, without a list of the steps: */
+        timer.start();
+        for (int i = 0; i < runs; ++i) {
+            ProofStream stream(binaryFile);
+            correct = stream.isFinished() && correct;
+        }
+        timer.stop();
+        report(QStringLiteral(correct ? "verify (binary, streamed)/%1" : "verify (binary, streamed)/%1 FAILED").arg(n),
+               timer, runs, runs * QFileInfo(binaryFile).size(), n);
+    }
+    QFile::remove(textFile);
+    QFile::remove(binaryFile);
+}
+
+/* A rule concluding a fresh variable is valid exactly when its premises are contradictory: */
+static Rule *contradictionRule(const QList<const Expression *> &premises)
+{
+    return new Rule(premises, QList<const Expression *>() << ExprFactory::makeVar(QStringLiteral("conclusion")));
+}
+
+static void benchValidity(const char *corpus, const QList<Rule *> &rules)
+{
+    int valid = 0;
+    Meter timer;
+    timer.start();
+    foreach (const Rule *rule, rules) {
+        if (Validity::isSound(*rule) == Validity::Holds)
+            ++valid;
+    }
+    timer.stop();
+    QString name = QStringLiteral("%1 %2/%3 valid").arg(corpus).arg(valid).arg(rules.size());
+    report(name, timer, rules.size());
+}
+
+static void benchSat(quint64 seed)
+{
+    Random random(seed);
+    /* Random 3-SAT at the threshold ratio, where about half of the instances are contradictory: */
+    for (int variables = 50; variables <= 200; variables += 50) {
+        QList<Rule *> rules;
+        for (int i = 0; i < 10; ++i) {
+            QList<const Expression *> clauses;
+            for (int c = 0; c < variables * 426 / 100; ++c) {
+                const Expression *clause = NULL;
+                for (int l = 0; l < 3; ++l) {
+                    const Expression *literal = ExprFactory::makeVar(randomVariable(random, variables));
+                    if (random.next(2))
+                        literal = ExprFactory::makeNOT(literal);
+                    clause = clause ? ExprFactory::makeOR(clause, literal) : literal;
+                }
+                clauses.append(clause);
+            }
+            rules.append(contradictionRule(clauses));
+        }
+        benchValidity(QStringLiteral("3sat/%1v").arg(variables).toLatin1().constData(), rules);
+        qDeleteAll(rules);
+    }
+    /* Pigeonhole: n + 1 pigeons each in one of n holes, no two in the same hole: */
+    for (int holes = 5; holes <= 8; ++holes) {
+        QList<const Expression *> premises;
+        for (int i = 0; i <= holes; ++i) {
+            const Expression *somewhere = ExprFactory::makeVar(variableName(i * holes));
+            for (int j = 1; j < holes; ++j)
+                somewhere = ExprFactory::makeOR(somewhere, ExprFactory::makeVar(variableName(i * holes + j)));
+            premises.append(somewhere);
+        }
+        for (int j = 0; j < holes; ++j) {
+            for (int i = 0; i <= holes; ++i) {
+                for (int k = i + 1; k <= holes; ++k) {
+                    premises.append(ExprFactory::makeNOT(ExprFactory::makeAND(ExprFactory::makeVar(variableName(i * holes + j)),
+                                                                               ExprFactory::makeVar(variableName(k * holes + j)))));
+                }
+            }
+        }
+        QList<Rule *> rules;
+        rules.append(contradictionRule(premises));
+        benchValidity(QStringLiteral("pigeonhole/%1").arg(holes).toLatin1().constData(), rules);
+        qDeleteAll(rules);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aubs-bench");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the throughput of the proof core on random formulas and rules.");
+    parser.addHelpOption();
+    QCommandLineOption countOption("count", "Number of formulas.", "n", "20000");
+    QCommandLineOption depthOption("depth", "Maximum formula depth.", "n", "12");
+    QCommandLineOption variablesOption("variables", "Number of distinct variables.", "n", "2000");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    QCommandLineOption maxSizeOption("max-size", "Largest formula and proof of the scaling runs, from 100 (0 for none).", "n", "1000000");
+    QCommandLineOption jsonOption("json", "File to write the results to, as JSON.", "file");
+    parser.addOption(countOption);
+    parser.addOption(depthOption);
+    parser.addOption(variablesOption);
+    parser.addOption(seedOption);
+    parser.addOption(maxSizeOption);
+    parser.addOption(jsonOption);
+    parser.process(app);
+    int count = parser.value(countOption).toInt();
+    int depth = parser.value(depthOption).toInt();
+    int variables = parser.value(variablesOption).toInt();
+    quint64 seed = parser.value(seedOption).toULongLong();
+    int maxSize = parser.value(maxSizeOption).toInt();
+    if ((count < 1) || (depth < 0) || (variables < 1) || (maxSize < 0)) {
+        fprintf(stderr, "%s", parser.helpText().toLocal8Bit().constData());
+        return 2;
+    }
+    /* First, so that its few variables get the first identifiers: */
+    benchScaling(maxSize, seed + 7);
+    benchParse(count, depth, variables, seed);
+    benchAdapt(count, depth, variables, seed + 1);
+    benchVariables(count, depth, variables, seed + 6);
+    benchEvaluate(qMin(depth, 4), seed + 2);
+    benchSat(seed + 3);
+    benchEquivalent(count, qMin(depth, 6), seed + 4);
+    benchIndex(10000, qBound(1, depth, 3), seed + 5);
+
+    if (parser.isSet(jsonOption)) {
+        QJsonObject root;
+        root.insert("seed", QString::number(seed));
+        root.insert("count", count);
+        root.insert("depth", depth);
+        root.insert("variables", variables);
+        root.insert("max_size", maxSize);
+        root.insert("counts_allocations", Meter::countsAllocations());
+        root.insert("peak_rss_kib", Meter::peakResidentKiB());
+        root.insert("results", getResults());
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly) || (file.write(QJsonDocument(root).toJson()) < 0)) {
+            fprintf(stderr, "%s: could not write the results\n", parser.value(jsonOption).toLocal8Bit().constData());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "meter.h"
+
+#include <QJsonObject>
+#include <QAtomicInteger>
+
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+static QAtomicInteger<qint64> allocationCount;
+static QJsonArray results;
+
+#ifdef __GLIBC__
+/* The replacements forward to the allocator of glibc, which it exports under these names: */
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer)
+{
+    __libc_free(pointer);
+}
+}
+#endif
+
+Meter::Meter() : allocationsAtStart(0), stoppedNsecs(0), stoppedAllocations(0), stopped(false) {}
+
+void Meter::start()
+{
+    stopped = false;
+    allocationsAtStart = allocationCount.load();
+    timer.start();
+}
+
+void Meter::stop()
+{
+    stoppedNsecs = timer.nsecsElapsed();
+    stoppedAllocations = allocationCount.load() - allocationsAtStart;
+    stopped = true;
+}
+
+qint64 Meter::nsecsElapsed() const
+{
+    return stopped ? stoppedNsecs : timer.nsecsElapsed();
+}
+
+qint64 Meter::allocations() const
+{
+    if (!countsAllocations())
+        return -1;
+    return stopped ? stoppedAllocations : allocationCount.load() - allocationsAtStart;
+}
+
+bool Meter::countsAllocations()
+{
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
+
+qint64 Meter::peakResidentKiB()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+void report(const QString &name, const Meter &meter, int operations, qint64 bytes, qint64 size)
+{
+    qint64 nsecs = meter.nsecsElapsed();
+    qint64 allocations = meter.allocations();
+    qint64 peak = Meter::peakResidentKiB();
+    double nsPerOp = double(nsecs) / qMax(operations, 1);
+    printf("%-24s %12.1f ns/op", name.toLatin1().constData(), nsPerOp);
+    if (allocations >= 0)
+        printf(" %10.1f allocs/op", double(allocations) / qMax(operations, 1));
+    if (bytes)
+        printf(" %10.2f MB/s", bytes * 1e3 / qMax(nsecs, qint64(1)));
+    printf("\n");
+
+    QJsonObject result;
+    result.insert("name", name);
+    if (size)
+        result.insert("size", size);
+    result.insert("operations", operations);
+    result.insert("ns_per_op", nsPerOp);
+    result.insert("allocs_per_op", (allocations >= 0) ? QJsonValue(double(allocations) / qMax(operations, 1)) : QJsonValue());
+    if (bytes)
+        result.insert("mb_per_s", bytes * 1e3 / qMax(nsecs, qint64(1)));
+    result.insert("peak_rss_kib", (peak >= 0) ? QJsonValue(peak) : QJsonValue());
+    results.append(result);
+}
+
+const QJsonArray &getResults()
+{
+    return results;
+}
@@ -0,0 +1,37 @@
+#ifndef METER_H
+#define METER_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QJsonArray>
+
+/*
+ * Wall time and heap allocations of a measured section. Allocations are
+ * counted by wrapping malloc, which only works with glibc; elsewhere they are
+ * reported as unknown (-1).
+ */
+class Meter
+{
+public:
+    Meter();
+    void start();
+    /* Freezes the measure, so that the work done before reporting it is not counted: */
+    void stop();
+    qint64 nsecsElapsed() const;
+    qint64 allocations() const;
+public:
+    static bool countsAllocations();
+    /* Peak resident set size of the process in KiB, -1 if unknown: */
+    static qint64 peakResidentKiB();
+private:
+    QElapsedTimer timer;
+    qint64 allocationsAtStart;
+    qint64 stoppedNsecs, stoppedAllocations;
+    bool stopped;
+};
+
+/* Prints one result, and keeps it for getResults(); the size is that of the inputs, if scaled: */
+void report(const QString &name, const Meter &meter, int operations, qint64 bytes = 0, qint64 size = 0);
+const QJsonArray &getResults();
+
+#endif // METER_H
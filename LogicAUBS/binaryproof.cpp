@@ -0,0 +1,425 @@
+#include "binaryproof.h"
+
+#include <QHash>
+#include <QByteArray>
+#include <QObject>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <climits>
+#include <cstring>
+
+#define BINARY_MAGIC 0x50425541 // "AUBP"
+#define BINARY_VERSION 1
+
+/* Header words: */
+enum { H_MAGIC, H_VERSION, H_STRINGS, H_STRING_BYTES, H_EXPRESSIONS, H_PREMISES, H_CONCLUSIONS,
+       H_STEPS, H_INPUTS, H_RENAMINGS, H_INDEXES, HEADER_WORDS };
+
+/* Record sizes, in words: */
+#define STRING_WORDS 2
+#define EXPRESSION_WORDS 3
+#define STEP_WORDS 8
+#define RENAMING_WORDS 2
+
+static inline quint32 readWord(const uchar *section, quint64 index)
+{
+    return qFromLittleEndian<quint32>(section + 4 * index);
+}
+
+static inline void writeWord(uchar *&out, quint32 value)
+{
+    qToLittleEndian<quint32>(value, out);
+    out += 4;
+}
+
+BinaryProof::BinaryProof(const QString &filename, bool formulas) : file(filename), data(NULL), valid(false),
+    stepRecords(NULL), inputs(NULL), renamings(NULL), indexes(NULL), stepCount(0), indexCount(0)
+{
+    valid = open(formulas);
+}
+
+BinaryProof::~BinaryProof()
+{
+    if (data)
+        file.unmap(const_cast<uchar *>(data));
+    file.close();
+}
+
+bool BinaryProof::isValid() const
+{
+    return valid;
+}
+
+QString BinaryProof::getLastError() const
+{
+    return lastError;
+}
+
+QSharedPointer<Rule> BinaryProof::getRule() const
+{
+    return rule;
+}
+
+int BinaryProof::getStepCount() const
+{
+    return stepCount;
+}
+
+const Expression *BinaryProof::getStepOutput(int index) const
+{
+    return expressions[readWord(stepRecords, quint64(index) * STEP_WORDS)];
+}
+
+QString BinaryProof::getStepRule(int index) const
+{
+    return strings[readWord(stepRecords, quint64(index) * STEP_WORDS + 1)];
+}
+
+int BinaryProof::getStepInputCount(int index) const
+{
+    return readWord(stepRecords, quint64(index) * STEP_WORDS + 3);
+}
+
+int BinaryProof::getStepInput(int index, int input) const
+{
+    return qint32(readWord(inputs, quint64(readWord(stepRecords, quint64(index) * STEP_WORDS + 2)) + input));
+}
+
+int BinaryProof::getStepRenamingCount(int index) const
+{
+    return readWord(stepRecords, quint64(index) * STEP_WORDS + 5);
+}
+
+QString BinaryProof::getStepRenamingVariable(int index, int renaming) const
+{
+    quint64 first = readWord(stepRecords, quint64(index) * STEP_WORDS + 4);
+    return strings[readWord(renamings, (first + renaming) * RENAMING_WORDS)];
+}
+
+const Expression *BinaryProof::getStepRenamingValue(int index, int renaming) const
+{
+    quint64 first = readWord(stepRecords, quint64(index) * STEP_WORDS + 4);
+    return expressions[readWord(renamings, (first + renaming) * RENAMING_WORDS + 1)];
+}
+
+int BinaryProof::getStepClIndex(int index) const
+{
+    return qint32(readWord(stepRecords, quint64(index) * STEP_WORDS + 6));
+}
+
+int BinaryProof::getStepIndentation(int index) const
+{
+    return qint32(readWord(stepRecords, quint64(index) * STEP_WORDS + 7));
+}
+
+Step BinaryProof::getStep(int index) const
+{
+    Step step;
+    step.output = getStepOutput(index);
+    step.rule = getStepRule(index);
+    step.basicRule = basicRules[readWord(stepRecords, quint64(index) * STEP_WORDS + 1)];
+    int n = getStepInputCount(index);
+    step.usedInputs.reserve(n);
+    for (int j = 0; j < n; ++j)
+        step.usedInputs.append(getStepInput(index, j));
+    for (int j = getStepRenamingCount(index); j-- > 0;)
+        step.renaming.insert(getStepRenamingVariable(index, j), getStepRenamingValue(index, j));
+    step.clIndex = getStepClIndex(index);
+    step.indentation = getStepIndentation(index);
+    return step;
+}
+
+/* Reuses the lists of the step, so that only the variables the previous step did not rename take new nodes: */
+void BinaryProof::readStep(int index, Step &step) const
+{
+    quint64 record = quint64(index) * STEP_WORDS;
+    quint32 rule = readWord(stepRecords, record + 1);
+    step.output = expressions[readWord(stepRecords, record)];
+    step.rule = strings[rule];
+    step.basicRule = basicRules[rule];
+    quint64 firstInput = readWord(stepRecords, record + 2);
+    int n = readWord(stepRecords, record + 3);
+    while (step.usedInputs.size() > n)
+        step.usedInputs.removeLast();
+    for (int j = 0; j < n; ++j) {
+        int input = qint32(readWord(inputs, firstInput + j));
+        if (j < step.usedInputs.size())
+            step.usedInputs[j] = input;
+        else
+            step.usedInputs.append(input);
+    }
+    quint64 firstRenaming = readWord(stepRecords, record + 4);
+    int count = readWord(stepRecords, record + 5);
+    QMap<QString, const Expression *>::iterator it = step.renaming.begin();
+    while (it != step.renaming.end()) {
+        bool renamed = false;
+        for (int j = 0; !renamed && (j < count); ++j)
+            renamed = (strings[readWord(renamings, (firstRenaming + j) * RENAMING_WORDS)] == it.key());
+        if (renamed)
+            ++it;
+        else
+            it = step.renaming.erase(it);
+    }
+    for (int j = count; j-- > 0;) {
+        quint64 renaming = (firstRenaming + j) * RENAMING_WORDS;
+        step.renaming.insert(strings[readWord(renamings, renaming)], expressions[readWord(renamings, renaming + 1)]);
+    }
+    step.clIndex = qint32(readWord(stepRecords, record + 6));
+    step.indentation = qint32(readWord(stepRecords, record + 7));
+}
+
+QList<int> BinaryProof::getStepIndexes() const
+{
+    QList<int> result;
+    result.reserve(indexCount);
+    for (int i = 0; i < indexCount; ++i)
+        result.append(qint32(readWord(indexes, i)));
+    return result;
+}
+
+bool BinaryProof::isBinaryFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray magic = file.read(4);
+    file.close();
+    return (magic.size() == 4) && (qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(magic.constData())) == BINARY_MAGIC);
+}
+
+bool BinaryProof::fail(const QString &error)
+{
+    lastError = error;
+    return false;
+}
+
+bool BinaryProof::open(bool formulas)
+{
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(QObject::tr("Could not open file for reading"));
+    qint64 size = file.size();
+    if (size < 4 * HEADER_WORDS)
+        return fail(QObject::tr("Invalid binary proof header"));
+    if (!(data = file.map(0, size)))
+        return fail(QObject::tr("Could not map the file"));
+    quint32 header[HEADER_WORDS];
+    for (int i = 0; i < HEADER_WORDS; ++i)
+        header[i] = readWord(data, i);
+    if (header[H_MAGIC] != BINARY_MAGIC)
+        return fail(QObject::tr("Invalid binary proof header"));
+    if (header[H_VERSION] != BINARY_VERSION)
+        return fail(QObject::tr("Unsupported binary proof version %1").arg(header[H_VERSION]));
+    if (!header[H_CONCLUSIONS])
+        return fail(QObject::tr("Invalid rule"));
+    if ((header[H_STEPS] > INT_MAX) || (header[H_INDEXES] > INT_MAX))
+        return fail(QObject::tr("Invalid binary proof header"));
+
+    /* Locate the sections; the file must hold exactly what the header announces: */
+    quint64 words = HEADER_WORDS + quint64(header[H_STRINGS]) * STRING_WORDS
+            + quint64(header[H_EXPRESSIONS]) * EXPRESSION_WORDS + header[H_PREMISES] + header[H_CONCLUSIONS]
+            + quint64(header[H_STEPS]) * STEP_WORDS + header[H_INPUTS]
+            + quint64(header[H_RENAMINGS]) * RENAMING_WORDS + header[H_INDEXES];
+    if (4 * words + header[H_STRING_BYTES] != quint64(size))
+        return fail(QObject::tr("Invalid binary proof size"));
+    const uchar *stringRecords = data + 4 * HEADER_WORDS;
+    const uchar *expressionRecords = stringRecords + 4 * quint64(header[H_STRINGS]) * STRING_WORDS;
+    const uchar *ruleRecords = expressionRecords + 4 * quint64(header[H_EXPRESSIONS]) * EXPRESSION_WORDS;
+    stepRecords = ruleRecords + 4 * (quint64(header[H_PREMISES]) + header[H_CONCLUSIONS]);
+    inputs = stepRecords + 4 * quint64(header[H_STEPS]) * STEP_WORDS;
+    renamings = inputs + 4 * quint64(header[H_INPUTS]);
+    indexes = renamings + 4 * quint64(header[H_RENAMINGS]) * RENAMING_WORDS;
+    const uchar *stringData = indexes + 4 * quint64(header[H_INDEXES]);
+    stepCount = header[H_STEPS];
+    indexCount = header[H_INDEXES];
+
+    /* Strings and expressions are decoded once; steps are only checked: */
+    strings.resize(header[H_STRINGS]);
+    for (quint32 i = 0; i < header[H_STRINGS]; ++i) {
+        quint64 offset = readWord(stringRecords, quint64(i) * STRING_WORDS);
+        quint64 length = readWord(stringRecords, quint64(i) * STRING_WORDS + 1);
+        if (offset + length > header[H_STRING_BYTES])
+            return fail(QObject::tr("Invalid string %1").arg(i));
+        strings[i] = QString::fromUtf8(reinterpret_cast<const char *>(stringData + offset), length);
+    }
+    basicRules.resize(strings.size());
+    for (int i = 0; i < strings.size(); ++i)
+        basicRules[i] = Proof::getBasicRule(strings[i]);
+    if (!formulas) {
+        for (int i = 0; i < stepCount; ++i) {
+            if (readWord(stepRecords, quint64(i) * STEP_WORDS + 1) >= header[H_STRINGS])
+                return fail(QObject::tr("Invalid step %1").arg(i));
+        }
+        return true;
+    }
+    expressions.resize(header[H_EXPRESSIONS]);
+    for (quint32 i = 0; i < header[H_EXPRESSIONS]; ++i) {
+        quint32 kind = readWord(expressionRecords, quint64(i) * EXPRESSION_WORDS);
+        quint32 a = readWord(expressionRecords, quint64(i) * EXPRESSION_WORDS + 1);
+        quint32 b = readWord(expressionRecords, quint64(i) * EXPRESSION_WORDS + 2);
+        const Expression *e = NULL;
+        if (kind == Expression::Variable) {
+            if (a < header[H_STRINGS])
+                e = ExprFactory::makeVar(strings[a]);
+        } else if (kind == Expression::NOT) {
+            if (a < i)
+                e = ExprFactory::makeNOT(expressions[a]);
+        } else if (kind <= Expression::Equiv) {
+            if ((a < i) && (b < i))
+                e = ExprFactory::make(Expression::Kind(kind), expressions[a], expressions[b]);
+        }
+        if (!e)
+            return fail(QObject::tr("Invalid formula %1").arg(i));
+        expressions[i] = e;
+    }
+    QList<const Expression *> premises, conclusions;
+    for (quint32 i = 0; i < header[H_PREMISES] + header[H_CONCLUSIONS]; ++i) {
+        quint32 e = readWord(ruleRecords, i);
+        if (e >= header[H_EXPRESSIONS])
+            return fail(QObject::tr("Invalid rule"));
+        if (i < header[H_PREMISES])
+            premises.append(expressions[e]);
+        else
+            conclusions.append(expressions[e]);
+    }
+    rule = QSharedPointer<Rule>(new Rule(premises, conclusions));
+    for (int i = 0; i < stepCount; ++i) {
+        quint64 record = quint64(i) * STEP_WORDS;
+        if ((readWord(stepRecords, record) >= header[H_EXPRESSIONS]) || (readWord(stepRecords, record + 1) >= header[H_STRINGS])
+                || (quint64(readWord(stepRecords, record + 2)) + readWord(stepRecords, record + 3) > header[H_INPUTS])
+                || (quint64(readWord(stepRecords, record + 4)) + readWord(stepRecords, record + 5) > header[H_RENAMINGS]))
+            return fail(QObject::tr("Invalid step %1").arg(i));
+    }
+    for (quint32 i = 0; i < header[H_RENAMINGS]; ++i) {
+        if ((readWord(renamings, quint64(i) * RENAMING_WORDS) >= header[H_STRINGS])
+                || (readWord(renamings, quint64(i) * RENAMING_WORDS + 1) >= header[H_EXPRESSIONS]))
+            return fail(QObject::tr("Wrong renaming rule"));
+    }
+    return true;
+}
+
+/* Collects the string and expression tables of a proof being written: */
+class BinaryProofTables
+{
+public:
+    quint32 addString(const QString &str)
+    {
+        QHash<QString, quint32>::const_iterator it = stringIndexes.constFind(str);
+        if (it != stringIndexes.constEnd())
+            return it.value();
+        QByteArray utf8 = str.toUtf8();
+        quint32 index = stringIndexes.size();
+        stringIndexes.insert(str, index);
+        stringRecords << quint32(stringData.size()) << quint32(utf8.size());
+        stringData.append(utf8);
+        return index;
+    }
+    quint32 addExpression(const Expression *e)
+    {
+        /* Postorder without recursion, so that operands always precede their operator: */
+        QVector<const Expression *> stack;
+        stack.append(e);
+        while (!stack.isEmpty()) {
+            const Expression *top = stack.last();
+            if (expressionIndexes.contains(top)) {
+                stack.removeLast();
+                continue;
+            }
+            int pending = stack.size();
+            for (int i = top->getChildCount(); i-- > 0;) {
+                if (!expressionIndexes.contains(top->getChild(i)))
+                    stack.append(top->getChild(i));
+            }
+            if (stack.size() > pending)
+                continue;
+            stack.removeLast();
+            quint32 a = 0, b = 0;
+            if (top->getKind() == Expression::Variable) {
+                a = addString(static_cast<const ExprVar *>(top)->getName());
+            } else {
+                a = expressionIndexes.value(top->getChild(0));
+                if (top->getChildCount() > 1)
+                    b = expressionIndexes.value(top->getChild(1));
+            }
+            expressionIndexes.insert(top, expressionIndexes.size());
+            expressionRecords << quint32(top->getKind()) << a << b;
+        }
+        return expressionIndexes.value(e);
+    }
+public:
+    QHash<QString, quint32> stringIndexes;
+    QHash<const Expression *, quint32> expressionIndexes;
+    QVector<quint32> stringRecords, expressionRecords;
+    QByteArray stringData;
+};
+
+bool BinaryProof::write(const QString &filename, const Rule &rule, const QList<Step> &steps,
+                        const QList<int> &stepIndexes, QString &error)
+{
+    BinaryProofTables tables;
+    QVector<quint32> ruleRecords, stepRecords, inputs, renamings;
+    foreach (const Expression *e, rule.getPremises())
+        ruleRecords.append(tables.addExpression(e));
+    QList<const Expression *> conclusions = rule.getConclusions();
+    foreach (const Expression *e, conclusions)
+        ruleRecords.append(tables.addExpression(e));
+    stepRecords.reserve(steps.size() * STEP_WORDS);
+    foreach (const Step &step, steps) {
+        stepRecords << tables.addExpression(step.output) << tables.addString(step.rule);
+        stepRecords << quint32(inputs.size()) << quint32(step.usedInputs.size());
+        foreach (int input, step.usedInputs)
+            inputs.append(quint32(input));
+        stepRecords << quint32(renamings.size() / RENAMING_WORDS) << quint32(step.renaming.size());
+        QMap<QString, const Expression *>::const_iterator it = step.renaming.constBegin();
+        while (it != step.renaming.constEnd()) {
+            renamings << tables.addString(it.key()) << tables.addExpression(it.value());
+            ++it;
+        }
+        stepRecords << quint32(step.clIndex) << quint32(step.indentation);
+    }
+
+    quint32 header[HEADER_WORDS];
+    header[H_MAGIC] = BINARY_MAGIC;
+    header[H_VERSION] = BINARY_VERSION;
+    header[H_STRINGS] = tables.stringIndexes.size();
+    header[H_STRING_BYTES] = tables.stringData.size();
+    header[H_EXPRESSIONS] = tables.expressionIndexes.size();
+    header[H_PREMISES] = ruleRecords.size() - conclusions.size();
+    header[H_CONCLUSIONS] = conclusions.size();
+    header[H_STEPS] = steps.size();
+    header[H_INPUTS] = inputs.size();
+    header[H_RENAMINGS] = renamings.size() / RENAMING_WORDS;
+    header[H_INDEXES] = stepIndexes.size();
+    QByteArray buffer(4 * (HEADER_WORDS + tables.stringRecords.size() + tables.expressionRecords.size()
+                           + ruleRecords.size() + stepRecords.size() + inputs.size() + renamings.size()
+                           + stepIndexes.size()) + tables.stringData.size(), '\0');
+    uchar *out = reinterpret_cast<uchar *>(buffer.data());
+    for (int i = 0; i < HEADER_WORDS; ++i)
+        writeWord(out, header[i]);
+    foreach (quint32 word, tables.stringRecords)
+        writeWord(out, word);
+    foreach (quint32 word, tables.expressionRecords)
+        writeWord(out, word);
+    foreach (quint32 word, ruleRecords)
+        writeWord(out, word);
+    foreach (quint32 word, stepRecords)
+        writeWord(out, word);
+    foreach (quint32 word, inputs)
+        writeWord(out, word);
+    foreach (quint32 word, renamings)
+        writeWord(out, word);
+    foreach (int index, stepIndexes)
+        writeWord(out, quint32(index));
+    memcpy(out, tables.stringData.constData(), tables.stringData.size());
+
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = QObject::tr("Could not open file for writing");
+        return false;
+    }
+    if ((file.write(buffer) != buffer.size()) || !file.commit()) {
+        error = QObject::tr("Could not write the file");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef BINARYPROOF_H
+#define BINARYPROOF_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QFile>
+#include <QSharedPointer>
+
+#include "proof.h"
+
+/*
+ * Binary proof format (version 1), all integers being 32-bit little-endian:
+ *   header      magic "AUBP", version, then the counts of every section below
+ *   strings     (offset, length) in the string data, one per distinct string
+ *   expressions (kind, a, b) in postorder: a variable refers to its name in the
+ *               string table, the other kinds to their operands, which always
+ *               come first (b is unused for ~)
+ *   rule        expression indexes of the premises, then of the conclusions
+ *   steps       (output, rule, first input, input count, first renaming,
+ *               renaming count, clIndex, indentation)
+ *   inputs      the used inputs of all steps, one contiguous array
+ *   renamings   (variable name, expression) pairs of all steps
+ *   indexes     the steps proving each conclusion
+ *   string data UTF-8 bytes of the strings
+ * Every section but the last one has a fixed record size, so a mapped file is
+ * read in place: BinaryProof checks the whole file once when it is opened and
+ * then serves the steps straight from the mapping.
+ * Only the editable Proof copies every step with getStep(); the read-only
+ * verifications (ProofStream, used for the lemmas and by the command line
+ * tools) decode the steps in turn into one Step with readStep(), which reuses
+ * its storage, so that they do not allocate per step.
+ */
+class BinaryProof
+{
+public:
+    /* Without the formulas, only the rules of the steps are read, for getStepRule(): */
+    BinaryProof(const QString &filename, bool formulas = true);
+    ~BinaryProof();
+    bool isValid() const;
+    QString getLastError() const;
+    QSharedPointer<Rule> getRule() const;
+    int getStepCount() const;
+    const Expression *getStepOutput(int index) const;
+    QString getStepRule(int index) const;
+    int getStepInputCount(int index) const;
+    int getStepInput(int index, int input) const;
+    int getStepRenamingCount(int index) const;
+    QString getStepRenamingVariable(int index, int renaming) const;
+    const Expression *getStepRenamingValue(int index, int renaming) const;
+    int getStepClIndex(int index) const;
+    int getStepIndentation(int index) const;
+    Step getStep(int index) const;
+    void readStep(int index, Step &step) const;
+    QList<int> getStepIndexes() const;
+public:
+    static bool isBinaryFile(const QString &filename);
+    static bool write(const QString &filename, const Rule &rule, const QList<Step> &steps,
+                      const QList<int> &stepIndexes, QString &error);
+private:
+    bool open(bool formulas);
+    bool fail(const QString &error);
+private:
+    QFile file;
+    const uchar *data;
+    bool valid;
+    QString lastError;
+    QSharedPointer<Rule> rule;
+    QVector<QString> strings;
+    /* Basic rule named by each string, if any: */
+    QVector<BasicRule> basicRules;
+    QVector<const Expression *> expressions;
+    const uchar *stepRecords, *inputs, *renamings, *indexes;
+    int stepCount, indexCount;
+};
+
+#endif // BINARYPROOF_H
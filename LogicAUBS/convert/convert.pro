@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Converter between the text and binary proof formats
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = aubs-convert
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += main.cpp
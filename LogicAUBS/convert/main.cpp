@@ -0,0 +1,49 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include <cstdio>
+
+#include "proof.h"
+#include "binaryproof.h"
+
+/* Exit codes: */
+#define EXIT_CONVERTED 0
+#define EXIT_FAILED 1
+#define EXIT_USAGE 2
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aubs-convert");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts a proof between the text (.aubs) and binary (.aubsb) formats.\n"
+                                     "By default, the output is in the format the input is not in.");
+    parser.addHelpOption();
+    QCommandLineOption textOption("text", "Write the output in the text format.");
+    QCommandLineOption binaryOption("binary", "Write the output in the binary format.");
+    parser.addOption(textOption);
+    parser.addOption(binaryOption);
+    parser.addPositionalArgument("input", "Proof file to read.");
+    parser.addPositionalArgument("output", "Proof file to write.");
+    parser.process(app);
+    QStringList arguments = parser.positionalArguments();
+    if ((arguments.size() != 2) || (parser.isSet(textOption) && parser.isSet(binaryOption))) {
+        fprintf(stderr, "%s", parser.helpText().toLocal8Bit().constData());
+        return EXIT_USAGE;
+    }
+    bool binary = !BinaryProof::isBinaryFile(arguments[0]);
+    if (parser.isSet(textOption) || parser.isSet(binaryOption))
+        binary = parser.isSet(binaryOption);
+
+    /* The proof is converted as it is, without verifying it: */
+    Proof proof(arguments[0], false);
+    if (proof.getRule().isNull() || !proof.getLastError().isEmpty()) {
+        fprintf(stderr, "%s: %s\n", arguments[0].toLocal8Bit().constData(), proof.getLastError().toLocal8Bit().constData());
+        return EXIT_FAILED;
+    }
+    if (!(binary ? proof.saveToBinaryFile(arguments[1]) : proof.saveToFile(arguments[1]))) {
+        fprintf(stderr, "%s: %s\n", arguments[1].toLocal8Bit().constData(), proof.getLastError().toLocal8Bit().constData());
+        return EXIT_FAILED;
+    }
+    return EXIT_CONVERTED;
+}
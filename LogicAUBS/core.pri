@@ -0,0 +1,32 @@
+# Proof model and verifier, shared by the application and the command-line tools.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/proof.cpp \
+    $$PWD/lemmacache.cpp \
+    $$PWD/binaryproof.cpp \
+    $$PWD/evaluator.cpp \
+    $$PWD/satsolver.cpp \
+    $$PWD/validity.cpp \
+    $$PWD/bdd.cpp \
+    $$PWD/ruleindex.cpp \
+    $$PWD/proofsearch.cpp
+
+HEADERS += \
+    $$PWD/proof.h \
+    $$PWD/lemmacache.h \
+    $$PWD/binaryproof.h \
+    $$PWD/evaluator.h \
+    $$PWD/satsolver.h \
+    $$PWD/validity.h \
+    $$PWD/bdd.h \
+    $$PWD/ruleindex.h \
+    $$PWD/proofsearch.h
+
+# Evaluates truth tables 256 assignments at a time (qmake CONFIG+=evaluator_avx2):
+evaluator_avx2: QMAKE_CXXFLAGS += $$QMAKE_CFLAGS_AVX2
+
+# Records where the verification time of each proof goes, see ProofProfile (qmake CONFIG+=proof_profile):
+proof_profile: DEFINES += AUBS_PROFILE
@@ -0,0 +1,388 @@
+#include "evaluator.h"
+
+#include <QHash>
+#include <QtAlgorithms>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* Truth tables of the first six variables over the 64 assignments of a word: */
+static const quint64 variablePatterns[6] = {
+    Q_UINT64_C(0xAAAAAAAAAAAAAAAA), Q_UINT64_C(0xCCCCCCCCCCCCCCCC), Q_UINT64_C(0xF0F0F0F0F0F0F0F0),
+    Q_UINT64_C(0xFF00FF00FF00FF00), Q_UINT64_C(0xFFFF0000FFFF0000), Q_UINT64_C(0xFFFFFFFF00000000)
+};
+
+/* Values of a variable over the word holding the assignments 64 * index to 64 * index + 63: */
+static inline quint64 variableWord(int variable, quint64 index)
+{
+    if (variable < 6)
+        return variablePatterns[variable];
+    return ((index >> (variable - 6)) & 1) ? ~Q_UINT64_C(0) : Q_UINT64_C(0);
+}
+
+/* 64 assignments in one machine word: */
+struct WordLane
+{
+    enum { Words = 1 };
+    quint64 w;
+    static inline WordLane load(const quint64 *p)
+    {
+        WordLane l;
+        l.w = *p;
+        return l;
+    }
+    inline void store(quint64 *p) const
+    {
+        *p = w;
+    }
+    inline WordLane operator~() const
+    {
+        return make(~w);
+    }
+    inline WordLane operator&(WordLane o) const
+    {
+        return make(w & o.w);
+    }
+    inline WordLane operator|(WordLane o) const
+    {
+        return make(w | o.w);
+    }
+    inline WordLane operator^(WordLane o) const
+    {
+        return make(w ^ o.w);
+    }
+    inline bool isZero() const
+    {
+        return !w;
+    }
+    static inline WordLane ones()
+    {
+        return make(~Q_UINT64_C(0));
+    }
+    static inline WordLane make(quint64 w)
+    {
+        WordLane l;
+        l.w = w;
+        return l;
+    }
+};
+
+#if defined(__AVX2__)
+/* 256 assignments in one AVX2 register: */
+struct WideLane
+{
+    enum { Words = 4 };
+    __m256i v;
+    static inline WideLane load(const quint64 *p)
+    {
+        return make(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+    }
+    inline void store(quint64 *p) const
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    inline WideLane operator~() const
+    {
+        return make(_mm256_xor_si256(v, ones().v));
+    }
+    inline WideLane operator&(WideLane o) const
+    {
+        return make(_mm256_and_si256(v, o.v));
+    }
+    inline WideLane operator|(WideLane o) const
+    {
+        return make(_mm256_or_si256(v, o.v));
+    }
+    inline WideLane operator^(WideLane o) const
+    {
+        return make(_mm256_xor_si256(v, o.v));
+    }
+    inline bool isZero() const
+    {
+        return _mm256_testz_si256(v, v);
+    }
+    static inline WideLane ones()
+    {
+        return make(_mm256_set1_epi64x(-1));
+    }
+    static inline WideLane make(__m256i v)
+    {
+        WideLane l;
+        l.v = v;
+        return l;
+    }
+};
+#endif
+
+/* Lanes evaluated per instruction, to keep the dispatch cost low: */
+#define EVALUATOR_BATCH 8
+
+/*
+ * Runs the program over every assignment, stopping at the first one that
+ * satisfies all the hypotheses and falsifies one of the goals.
+ */
+template<class Lane>
+static bool searchLanes(const QVector<Evaluator::Instruction> &program, int variableCount, const QList<int> &hypotheses,
+                        const QList<int> &goals, int *failing, quint64 *assignment)
+{
+    const int step = Lane::Words, words = step * EVALUATOR_BATCH;
+    QVector<quint64> registers(program.size() * words);
+    QVector<int> hypothesisSlots = hypotheses.toVector(), goalSlots = goals.toVector();
+    const Evaluator::Instruction *code = program.constData();
+    quint64 *r = registers.data();
+    quint64 total = Q_UINT64_C(1) << variableCount;
+    quint64 blocks = qMax(total / (64 * words), Q_UINT64_C(1));
+    for (quint64 block = 0; block < blocks; ++block) {
+        quint64 firstWord = block * words;
+        for (int i = 0; i < program.size(); ++i) {
+            quint64 *out = r + i * words;
+            const quint64 *a = (code[i].op == Evaluator::Var) ? NULL : r + code[i].a * words;
+            const quint64 *b = (code[i].b < 0) ? NULL : r + code[i].b * words;
+            switch (code[i].op) {
+            case Evaluator::Var:
+                for (int j = 0; j < words; ++j)
+                    out[j] = variableWord(code[i].a, firstWord + j);
+                break;
+            case Evaluator::Not:
+                for (int j = 0; j < words; j += step)
+                    (~Lane::load(a + j)).store(out + j);
+                break;
+            case Evaluator::And:
+                for (int j = 0; j < words; j += step)
+                    (Lane::load(a + j) & Lane::load(b + j)).store(out + j);
+                break;
+            case Evaluator::Or:
+                for (int j = 0; j < words; j += step)
+                    (Lane::load(a + j) | Lane::load(b + j)).store(out + j);
+                break;
+            case Evaluator::Imply:
+                for (int j = 0; j < words; j += step)
+                    (~Lane::load(a + j) | Lane::load(b + j)).store(out + j);
+                break;
+            case Evaluator::Equiv:
+                for (int j = 0; j < words; j += step)
+                    (~(Lane::load(a + j) ^ Lane::load(b + j))).store(out + j);
+                break;
+            }
+        }
+        for (int j = 0; j < words; j += step) {
+            Lane premises = Lane::ones();
+            for (int h = 0; h < hypothesisSlots.size(); ++h)
+                premises = premises & Lane::load(r + hypothesisSlots[h] * words + j);
+            if (premises.isZero())
+                continue;
+            for (int g = 0; g < goalSlots.size(); ++g) {
+                Lane bad = premises & ~Lane::load(r + goalSlots[g] * words + j);
+                if (bad.isZero())
+                    continue;
+                quint64 bits[Lane::Words];
+                bad.store(bits);
+                int k = 0;
+                while (!bits[k])
+                    ++k;
+                if (failing)
+                    *failing = g;
+                if (assignment)
+                    *assignment = ((firstWord + j + k) * 64 + qCountTrailingZeroBits(bits[k])) & (total - 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Evaluator::Evaluator(const QList<const Expression *> &formulas)
+{
+    QHash<const Expression *, int> indexes;
+    QHash<QString, int> variableIndexes;
+    roots.reserve(formulas.size());
+    foreach (const Expression *formula, formulas) {
+        /* Postorder without recursion, so that operands always precede their operator: */
+        QVector<const Expression *> stack;
+        stack.append(formula);
+        while (!stack.isEmpty()) {
+            const Expression *top = stack.last();
+            if (indexes.contains(top)) {
+                stack.removeLast();
+                continue;
+            }
+            int pending = stack.size();
+            for (int i = top->getChildCount(); i-- > 0;) {
+                if (!indexes.contains(top->getChild(i)))
+                    stack.append(top->getChild(i));
+            }
+            if (stack.size() > pending)
+                continue;
+            stack.removeLast();
+            Instruction instruction;
+            instruction.b = -1;
+            switch (top->getKind()) {
+            case Expression::Variable:
+            {
+                const QString &name = static_cast<const ExprVar *>(top)->getName();
+                if (!variableIndexes.contains(name)) {
+                    variableIndexes.insert(name, variables.size());
+                    variables.append(name);
+                }
+                instruction.op = Var;
+                instruction.a = variableIndexes.value(name);
+                break;
+            }
+            case Expression::NOT:
+                instruction.op = Not;
+                break;
+            case Expression::OR:
+                instruction.op = Or;
+                break;
+            case Expression::AND:
+                instruction.op = And;
+                break;
+            case Expression::Imply:
+                instruction.op = Imply;
+                break;
+            case Expression::Equiv:
+                instruction.op = Equiv;
+                break;
+            }
+            if (instruction.op != Var) {
+                instruction.a = indexes.value(top->getChild(0));
+                if (top->getChildCount() > 1)
+                    instruction.b = indexes.value(top->getChild(1));
+            }
+            indexes.insert(top, program.size());
+            program.append(instruction);
+        }
+        roots.append(indexes.value(formula));
+    }
+}
+
+const QStringList &Evaluator::getVariables() const
+{
+    return variables;
+}
+
+const QVector<Evaluator::Instruction> &Evaluator::getProgram() const
+{
+    return program;
+}
+
+int Evaluator::getRoot(int formula) const
+{
+    return roots[formula];
+}
+
+bool Evaluator::evaluate(int formula, quint64 assignment) const
+{
+    QVector<bool> values(program.size());
+    for (int i = 0; i < program.size(); ++i) {
+        const Instruction &instruction = program[i];
+        switch (instruction.op) {
+        case Var:
+            values[i] = (assignment >> instruction.a) & 1;
+            break;
+        case Not:
+            values[i] = !values[instruction.a];
+            break;
+        case And:
+            values[i] = values[instruction.a] && values[instruction.b];
+            break;
+        case Or:
+            values[i] = values[instruction.a] || values[instruction.b];
+            break;
+        case Imply:
+            values[i] = !values[instruction.a] || values[instruction.b];
+            break;
+        case Equiv:
+            values[i] = (values[instruction.a] == values[instruction.b]);
+            break;
+        }
+    }
+    return values[roots[formula]];
+}
+
+Evaluator::Result Evaluator::findCounterexample(const QList<int> &hypotheses, int goal, quint64 *assignment, Mode mode) const
+{
+    QList<int> hypothesisRoots, goalRoots;
+    foreach (int h, hypotheses)
+        hypothesisRoots.append(roots[h]);
+    goalRoots.append(roots[goal]);
+    return search(hypothesisRoots, goalRoots, NULL, assignment, mode);
+}
+
+QMap<QString, bool> Evaluator::getAssignment(quint64 assignment) const
+{
+    QMap<QString, bool> result;
+    for (int v = 0; v < variables.size(); ++v)
+        result.insert(variables[v], (assignment >> v) & 1);
+    return result;
+}
+
+Evaluator::Result Evaluator::search(const QList<int> &hypotheses, const QList<int> &goals, int *failing,
+                                    quint64 *assignment, Mode mode) const
+{
+    if (variables.size() > maxVariables)
+        return TooManyVariables;
+    bool found;
+#if defined(__AVX2__)
+    if (mode == Auto)
+        found = searchLanes<WideLane>(program, variables.size(), hypotheses, goals, failing, assignment);
+    else
+#else
+    Q_UNUSED(mode)
+#endif
+        found = searchLanes<WordLane>(program, variables.size(), hypotheses, goals, failing, assignment);
+    return found ? Fails : Holds;
+}
+
+bool Evaluator::hasSimd()
+{
+#if defined(__AVX2__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+Evaluator::Result Evaluator::entails(const Rule &rule, int conclusion, QMap<QString, bool> *counterexample)
+{
+    QList<const Expression *> formulas = rule.getPremises();
+    QList<int> hypotheses;
+    for (int i = 0; i < formulas.size(); ++i)
+        hypotheses.append(i);
+    formulas.append(rule.getConclusions().at(conclusion));
+    Evaluator evaluator(formulas);
+    quint64 assignment;
+    Result result = evaluator.findCounterexample(hypotheses, formulas.size() - 1, &assignment);
+    if ((result == Fails) && counterexample)
+        *counterexample = evaluator.getAssignment(assignment);
+    return result;
+}
+
+Evaluator::Result Evaluator::isSound(const Rule &rule, int *failing, QMap<QString, bool> *counterexample)
+{
+    QList<const Expression *> premises = rule.getPremises(), conclusions = rule.getConclusions();
+    QList<const Expression *> formulas = premises;
+    formulas += conclusions;
+    Evaluator evaluator(formulas);
+    QList<int> hypotheses, goals;
+    for (int i = 0; i < premises.size(); ++i)
+        hypotheses.append(evaluator.roots[i]);
+    for (int i = 0; i < conclusions.size(); ++i)
+        goals.append(evaluator.roots[premises.size() + i]);
+    quint64 assignment;
+    Result result = evaluator.search(hypotheses, goals, failing, &assignment, Auto);
+    if ((result == Fails) && counterexample)
+        *counterexample = evaluator.getAssignment(assignment);
+    return result;
+}
+
+Evaluator::Result Evaluator::isTautology(const Expression *e, QMap<QString, bool> *counterexample)
+{
+    Evaluator evaluator(QList<const Expression *>() << e);
+    quint64 assignment;
+    Result result = evaluator.findCounterexample(QList<int>(), 0, &assignment);
+    if ((result == Fails) && counterexample)
+        *counterexample = evaluator.getAssignment(assignment);
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#include "proof.h"
+
+/*
+ * Semantic checks by exhaustive evaluation. A set of formulas is compiled to
+ * one flat postorder program, in which a subformula shared by several formulas
+ * appears once. The program is then run over all the assignments of the
+ * variables, 64 assignments at a time on machine words (256 at a time when
+ * built with AVX2), so that a rule over a few variables is checked in
+ * microseconds and a counterexample comes out of the first failing word.
+ * Variable v of an assignment is its bit v, in the order of getVariables().
+ */
+class Evaluator
+{
+public:
+    enum Op { Var, Not, And, Or, Imply, Equiv };
+    struct Instruction
+    {
+        Op op;
+        int a, b;
+    };
+    enum Result { Holds, Fails, TooManyVariables };
+    enum Mode { Auto, Scalar };
+    static const int maxVariables = 24;
+public:
+    Evaluator(const QList<const Expression *> &formulas);
+    const QStringList &getVariables() const;
+    const QVector<Instruction> &getProgram() const;
+    int getRoot(int formula) const;
+    bool evaluate(int formula, quint64 assignment) const;
+    Result findCounterexample(const QList<int> &hypotheses, int goal, quint64 *assignment = NULL, Mode mode = Auto) const;
+    QMap<QString, bool> getAssignment(quint64 assignment) const;
+public:
+    static bool hasSimd();
+    static Result entails(const Rule &rule, int conclusion, QMap<QString, bool> *counterexample = NULL);
+    static Result isSound(const Rule &rule, int *failing = NULL, QMap<QString, bool> *counterexample = NULL);
+    static Result isTautology(const Expression *e, QMap<QString, bool> *counterexample = NULL);
+private:
+    Result search(const QList<int> &hypotheses, const QList<int> &goals, int *failing, quint64 *assignment, Mode mode) const;
+private:
+    QStringList variables;
+    QVector<Instruction> program;
+    QVector<int> roots;
+};
+
+#endif // EVALUATOR_H
@@ -0,0 +1,442 @@
+#include "corpusgenerator.h"
+
+#include <QDir>
+#include <QObject>
+#include <QtAlgorithms>
+
+/* Formulas larger than this many nodes are not combined further: */
+#define SIZE_LIMIT_PER_OPERAND 8
+/* Random steps tried before one is copied with :Conclusion: */
+#define DERIVE_ATTEMPTS 4
+/* Premises of the proofs, and at most of the lemmas: */
+#define PROOF_PREMISES 4
+#define LEMMA_MAX_PREMISES 3
+
+static const char *const lemmaPremiseNames[LEMMA_MAX_PREMISES] = { "X", "Y", "Z" };
+
+static QString variableName(int k)
+{
+    QString name;
+    do {
+        name += QChar('a' + k % 26);
+        k /= 26;
+    } while (k);
+    return name;
+}
+
+static int formulaSize(const Expression *e)
+{
+    int size = 0;
+    QVector<const Expression *> stack;
+    stack.append(e);
+    while (!stack.isEmpty()) {
+        const Expression *top = stack.takeLast();
+        ++size;
+        for (int i = top->getChildCount(); i-- > 0;)
+            stack.append(top->getChild(i));
+    }
+    return size;
+}
+
+static QMap<QString, const Expression *> renamingXY(const Expression *x, const Expression *y = NULL)
+{
+    QMap<QString, const Expression *> renaming;
+    renaming.insert("X", x);
+    if (y)
+        renaming.insert("Y", y);
+    return renaming;
+}
+
+CorpusGenerator::CorpusGenerator(const Settings &settings) : settings(settings), state(settings.seed ? settings.seed : 1) {}
+
+/* Xorshift, so that a corpus only depends on its seed: */
+uint CorpusGenerator::next(uint bound)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return uint(state % qMax(bound, 1u));
+}
+
+const Expression *CorpusGenerator::randomLiteral()
+{
+    const Expression *var = ExprFactory::makeVar(variableName(next(4 * qMax(settings.width, 2))));
+    return next(3) ? var : ExprFactory::makeNOT(var);
+}
+
+/* A chain of the given number of literals, or an implication or equivalence between two shorter ones: */
+const Expression *CorpusGenerator::randomFormula(int width)
+{
+    if (width <= 1)
+        return randomLiteral();
+    if (!next(3)) {
+        int left = 1 + next(width - 1);
+        return ExprFactory::make(next(2) ? Expression::Imply : Expression::Equiv, randomFormula(left), randomFormula(width - left));
+    }
+    Expression::Kind kind = next(2) ? Expression::AND : Expression::OR;
+    const Expression *result = randomLiteral();
+    for (int i = 1; i < width; ++i)
+        result = ExprFactory::make(kind, randomLiteral(), result);
+    return result;
+}
+
+/* Lemmas a lemma (or a proof, for -1) may call; they all have a larger index: */
+QList<int> CorpusGenerator::getDependencies(int lemma)
+{
+    QList<int> result;
+    int count = settings.lemmas;
+    if (lemma < 0) {
+        if ((settings.shape == Chain) || (settings.shape == Tree)) {
+            if (count)
+                result.append(0);
+        } else {
+            for (int i = 0; i < count; ++i)
+                result.append(i);
+        }
+        return result;
+    }
+    switch (settings.shape) {
+    case Flat:
+        break;
+    case Chain:
+        if (lemma + 1 < count)
+            result.append(lemma + 1);
+        break;
+    case Tree:
+        for (int child = 2 * lemma + 1; (child <= 2 * lemma + 2) && (child < count); ++child)
+            result.append(child);
+        break;
+    case Dag:
+        for (int k = 0; (k < 2) && (lemma + 1 < count); ++k) {
+            int callee = lemma + 1 + next(count - lemma - 1);
+            if (!result.contains(callee))
+                result.append(callee);
+        }
+        break;
+    }
+    return result;
+}
+
+int CorpusGenerator::addStep(const QString &rule, const QList<int> &inputs, const QMap<QString, const Expression *> &renaming,
+                             int clIndex, const Expression *output, int size)
+{
+    Step step;
+    step.rule = rule;
+    step.basicRule = Proof::getBasicRule(rule);
+    step.usedInputs = inputs;
+    step.renaming = renaming;
+    step.clIndex = clIndex;
+    step.output = output;
+    step.indentation = assumptions.size();
+    int index = steps.size();
+    steps.append(step);
+    sizes.append(size);
+    available.last().append(index);
+    if (!derived.last().contains(output))
+        derived.last().insert(output, index);
+    return index;
+}
+
+/* A step available in the current scope, any open scope being as likely as its share of the steps: */
+int CorpusGenerator::randomFact()
+{
+    int total = 0;
+    for (int level = 0; level < available.size(); ++level)
+        total += available[level].size();
+    int k = next(total);
+    for (int level = 0; level < available.size(); ++level) {
+        if (k < available[level].size())
+            return available[level][k];
+        k -= available[level].size();
+    }
+    return 0;
+}
+
+int CorpusGenerator::findFact(const Expression *formula) const
+{
+    for (int level = derived.size(); level-- > 0;) {
+        int index = derived[level].value(formula, -1);
+        if (index >= 0)
+            return index;
+    }
+    return -1;
+}
+
+/* Attempts to apply an introduction or elimination rule to random steps, and falls back to a copy: */
+void CorpusGenerator::deriveStep()
+{
+    int limit = SIZE_LIMIT_PER_OPERAND * qMax(settings.width, 2);
+    int a = 0;
+    for (int attempt = 0; attempt < DERIVE_ATTEMPTS; ++attempt) {
+        a = randomFact();
+        const Expression *f = steps[a].output;
+        const Expression *x = f->getChild(0), *y = f->getChild(1);
+        int cl = next(2);
+        switch (next(4)) {
+        case 0:
+        {
+            int b = randomFact();
+            if (sizes[a] + sizes[b] >= limit)
+                continue;
+            const Expression *g = steps[b].output;
+            addStep(":IntroAnd", QList<int>() << a << b, renamingXY(f, g), 0, ExprFactory::makeAND(f, g), sizes[a] + sizes[b] + 1);
+            return;
+        }
+        case 1:
+        {
+            if (sizes[a] >= limit)
+                continue;
+            const Expression *g = randomFormula(1 + next(settings.width));
+            addStep(":IntroOr", QList<int>() << a, renamingXY(f, g), cl,
+                    cl ? ExprFactory::makeOR(g, f) : ExprFactory::makeOR(f, g), sizes[a] + formulaSize(g) + 1);
+            return;
+        }
+        default:
+            break;
+        }
+        switch (f->getKind()) {
+        case Expression::AND:
+            addStep(":ElimAnd", QList<int>() << a, renamingXY(x, y), cl, cl ? y : x, formulaSize(cl ? y : x));
+            return;
+        case Expression::Equiv:
+            addStep(":ElimEquiv", QList<int>() << a, renamingXY(x, y), cl,
+                    cl ? ExprFactory::makeImply(y, x) : ExprFactory::makeImply(x, y), sizes[a]);
+            return;
+        case Expression::Imply:
+        {
+            int premise = findFact(x);
+            if (premise < 0)
+                continue;
+            addStep(":ElimArrow", QList<int>() << premise << a, renamingXY(x, y), 0, y, formulaSize(y));
+            return;
+        }
+        default:
+            continue;
+        }
+    }
+    addStep(":Conclusion", QList<int>() << a, renamingXY(steps[a].output), 0, steps[a].output, sizes[a]);
+}
+
+/* The lemma premises are variables, bound to available steps: */
+void CorpusGenerator::callLemma(int lemma)
+{
+    QSharedPointer<Rule> rule = lemmaRules[lemma];
+    QMap<QString, const Expression *> renaming;
+    QList<int> inputs;
+    foreach (const Expression *premise, rule->getPremises()) {
+        int input = randomFact();
+        inputs.append(input);
+        renaming.insert(static_cast<const ExprVar *>(premise)->getName(), steps[input].output);
+    }
+    int cl = next(rule->getConclusions().size());
+    const Expression *output = Substitution(renaming).apply(rule->getConclusions()[cl]);
+    addStep(getLemmaName(lemma), inputs, renaming, cl, output, formulaSize(output));
+}
+
+void CorpusGenerator::openScope()
+{
+    const Expression *assumed = randomFormula(1 + next(settings.width));
+    assumptions.append(steps.size());
+    available.append(QVector<int>());
+    derived.append(QHash<const Expression *, int>());
+    addStep(":Assume", QList<int>(), renamingXY(assumed), 0, assumed, formulaSize(assumed));
+}
+
+/* Concludes the implication from the assumption to a step of the innermost scope: */
+void CorpusGenerator::closeScope()
+{
+    const Expression *assumed = steps[assumptions.last()].output;
+    const QVector<int> &inner = available.last();
+    int b = inner[next(inner.size())];
+    const Expression *concluded = steps[b].output;
+    int size = sizes[assumptions.last()] + sizes[b] + 1;
+    assumptions.removeLast();
+    available.removeLast();
+    derived.removeLast();
+    addStep(":IntroArrow", QList<int>() << b, renamingXY(assumed, concluded), 0, ExprFactory::makeImply(assumed, concluded), size);
+}
+
+QSharedPointer<Rule> CorpusGenerator::generateProof(const QList<const Expression *> &premises, int stepCount,
+                                                    const QList<int> &callees, QList<int> &stepIndexes)
+{
+    steps.clear();
+    sizes.clear();
+    available.fill(QVector<int>(), 1);
+    derived.fill(QHash<const Expression *, int>(), 1);
+    assumptions.clear();
+    foreach (const Expression *premise, premises)
+        addStep("-", QList<int>(), QMap<QString, const Expression *>(), 0, premise, formulaSize(premise));
+    stepCount = qMax(stepCount, premises.size());
+
+    /* The lemma calls happen at steps drawn beforehand, so that there are as many as requested: */
+    QList<int> callSteps;
+    if (!callees.isEmpty() && (stepCount > premises.size())) {
+        for (int k = 0; k < settings.fanOut; ++k)
+            callSteps.append(premises.size() + next(stepCount - premises.size()));
+        qSort(callSteps);
+    }
+    int calls = 0;
+    while (steps.size() < stepCount) {
+        int left = stepCount - steps.size();
+        if (left <= assumptions.size()) {
+            closeScope();
+        } else if ((calls < callSteps.size()) && (steps.size() >= callSteps[calls])) {
+            callLemma(callees[next(callees.size())]);
+            ++calls;
+        } else {
+            switch (next(8)) {
+            case 0:
+                if ((assumptions.size() < settings.depth) && (left > assumptions.size() + 2))
+                    openScope();
+                else
+                    deriveStep();
+                break;
+            case 1:
+                if (!assumptions.isEmpty())
+                    closeScope();
+                else
+                    deriveStep();
+                break;
+            default:
+                deriveStep();
+                break;
+            }
+        }
+    }
+
+    /* The last step, at the top level, and possibly another formula derived there: */
+    QList<const Expression *> conclusions;
+    stepIndexes.clear();
+    stepIndexes.append(steps.size() - 1);
+    int other = available.first()[next(available.first().size())];
+    if (next(2) && (other != stepIndexes.first()))
+        stepIndexes.prepend(other);
+    foreach (int index, stepIndexes)
+        conclusions.append(steps[index].output);
+    return QSharedPointer<Rule>(new Rule(premises, conclusions));
+}
+
+/* Alters one step after the premises, so that it is wrong whatever the other steps: */
+CorpusGenerator::Defect CorpusGenerator::breakProof(int premiseCount, int &defectStep)
+{
+    defectStep = -1;
+    if (steps.size() <= premiseCount)
+        return NoDefect;
+    defectStep = premiseCount + next(steps.size() - premiseCount);
+    Step &step = steps[defectStep];
+    Defect defect = Defect(WrongOutput + next(4));
+    if ((defect == WrongInput) && step.usedInputs.isEmpty())
+        defect = WrongOutput;
+    switch (defect) {
+    case WrongInput:
+        step.usedInputs[0] = defectStep;
+        break;
+    case WrongIndentation:
+        ++step.indentation;
+        break;
+    case UnknownRule:
+        step.rule = ":Unknown";
+        step.basicRule = NoBasicRule;
+        break;
+    default:
+        step.output = ExprFactory::makeNOT(step.output);
+        break;
+    }
+    return defect;
+}
+
+bool CorpusGenerator::write(const QString &path, QSharedPointer<Rule> rule, const QList<int> &stepIndexes)
+{
+    /* The steps are known to be valid (or not): they are not verified before being written: */
+    Proof proof(rule, steps, stepIndexes, false);
+    if (settings.binary ? proof.saveToBinaryFile(path) : proof.saveToFile(path))
+        return true;
+    lastError = path + ": " + proof.getLastError();
+    return false;
+}
+
+bool CorpusGenerator::generate(const QString &directory)
+{
+    QDir dir(directory);
+    if (!QDir().mkpath(directory)) {
+        lastError = QObject::tr("Could not create the directory %1.").arg(directory);
+        return false;
+    }
+    files.clear();
+    lemmaRules.fill(QSharedPointer<Rule>(), settings.lemmas);
+    for (int lemma = settings.lemmas; lemma-- > 0;) {
+        QList<const Expression *> premises;
+        int premiseCount = 1 + next(LEMMA_MAX_PREMISES);
+        for (int k = 0; k < premiseCount; ++k)
+            premises.append(ExprFactory::makeVar(lemmaPremiseNames[k]));
+        QList<int> stepIndexes;
+        lemmaRules[lemma] = generateProof(premises, settings.lemmaSteps, getDependencies(lemma), stepIndexes);
+        File file;
+        file.name = getLemmaName(lemma);
+        file.steps = steps.size();
+        file.defect = NoDefect;
+        file.defectStep = -1;
+        if (!write(dir.filePath(file.name), lemmaRules[lemma], stepIndexes))
+            return false;
+        files.append(file);
+    }
+    QList<int> callees = getDependencies(-1);
+    for (int proof = 0; proof < settings.proofs; ++proof) {
+        /* A chain of implications from a first premise, for :ElimArrow to use: */
+        QList<const Expression *> premises;
+        premises.append(randomFormula(settings.width));
+        for (int k = 1; k < PROOF_PREMISES; ++k) {
+            const Expression *consequent = randomFormula(settings.width);
+            premises.append(ExprFactory::makeImply(k > 1 ? premises.last()->getChild(1) : premises.first(), consequent));
+        }
+        QList<int> stepIndexes;
+        QSharedPointer<Rule> rule = generateProof(premises, settings.steps, callees, stepIndexes);
+        File file;
+        file.name = getProofName(proof);
+        file.defect = NoDefect;
+        file.defectStep = -1;
+        if (next(1000000) < settings.broken * 1000000)
+            file.defect = breakProof(premises.size(), file.defectStep);
+        file.steps = steps.size();
+        if (!write(dir.filePath(file.name), rule, stepIndexes))
+            return false;
+        files.append(file);
+    }
+    return true;
+}
+
+const QList<CorpusGenerator::File> &CorpusGenerator::getFiles() const
+{
+    return files;
+}
+
+QString CorpusGenerator::getLastError() const
+{
+    return lastError;
+}
+
+QString CorpusGenerator::getLemmaName(int lemma) const
+{
+    return QStringLiteral("lemma%1.%2").arg(lemma).arg(settings.binary ? "aubsb" : "aubs");
+}
+
+QString CorpusGenerator::getProofName(int proof) const
+{
+    return QStringLiteral("proof%1.%2").arg(proof).arg(settings.binary ? "aubsb" : "aubs");
+}
+
+QString CorpusGenerator::getDefectName(Defect defect)
+{
+    switch (defect) {
+    case WrongOutput:
+        return "wrong-output";
+    case WrongInput:
+        return "wrong-input";
+    case WrongIndentation:
+        return "wrong-indentation";
+    case UnknownRule:
+        return "unknown-rule";
+    default:
+        return "none";
+    }
+}
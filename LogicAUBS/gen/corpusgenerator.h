@@ -0,0 +1,91 @@
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QSharedPointer>
+
+#include "proof.h"
+
+/*
+ * Generator of synthetic proofs, valid by construction: the steps are drawn
+ * forward from the premises with the basic rules and calls to lemmas, and the
+ * rule of the proof concludes some of the formulas derived at the top level.
+ * Lemmas take variables as premises, so that any available formulas can be
+ * passed to them; they are generated first, in an order compatible with their
+ * dependencies. A broken proof is a valid one in which a single step is
+ * altered. Everything is drawn from the seed, so that a corpus can be
+ * generated again identically.
+ */
+class CorpusGenerator
+{
+public:
+    enum Shape { Flat, Chain, Tree, Dag };
+    enum Defect { NoDefect, WrongOutput, WrongInput, WrongIndentation, UnknownRule };
+    struct Settings
+    {
+        quint64 seed;
+        int proofs, lemmas;
+        int steps, lemmaSteps;
+        /* Maximum nesting of :Assume scopes, operands of the generated formulas, lemma calls per proof: */
+        int depth, width, fanOut;
+        Shape shape;
+        /* Fraction of the proofs (not lemmas) that are broken: */
+        double broken;
+        bool binary;
+    };
+    struct File
+    {
+        QString name;
+        int steps;
+        Defect defect;
+        int defectStep;
+    };
+public:
+    CorpusGenerator(const Settings &settings);
+    /* Writes the lemmas, then the proofs, to the directory; the files written are listed by getFiles(): */
+    bool generate(const QString &directory);
+    const QList<File> &getFiles() const;
+    QString getLastError() const;
+    QString getLemmaName(int lemma) const;
+    QString getProofName(int proof) const;
+public:
+    static QString getDefectName(Defect defect);
+private:
+    uint next(uint bound);
+    const Expression *randomLiteral();
+    const Expression *randomFormula(int width);
+    QList<int> getDependencies(int lemma);
+    /* Fills the steps, and returns the rule they prove: */
+    QSharedPointer<Rule> generateProof(const QList<const Expression *> &premises, int stepCount, const QList<int> &callees,
+                                       QList<int> &stepIndexes);
+    int addStep(const QString &rule, const QList<int> &inputs, const QMap<QString, const Expression *> &renaming,
+                int clIndex, const Expression *output, int size);
+    int randomFact();
+    int findFact(const Expression *formula) const;
+    void deriveStep();
+    void callLemma(int lemma);
+    void openScope();
+    void closeScope();
+    Defect breakProof(int premiseCount, int &defectStep);
+    bool write(const QString &path, QSharedPointer<Rule> rule, const QList<int> &stepIndexes);
+private:
+    Settings settings;
+    quint64 state;
+    QList<File> files;
+    QString lastError;
+    QVector< QSharedPointer<Rule> > lemmaRules;
+    /* State of the proof being generated: its steps, the size of their outputs, and for each open
+     * scope (the top level first) the steps available in it and the formulas they derive: */
+    QList<Step> steps;
+    QVector<int> sizes;
+    QVector< QVector<int> > available;
+    QVector< QHash<const Expression *, int> > derived;
+    QVector<int> assumptions;
+};
+
+#endif // CORPUSGENERATOR_H
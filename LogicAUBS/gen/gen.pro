@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Synthetic proof corpus generator
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = aubs-gen
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += main.cpp \
+    corpusgenerator.cpp
+
+HEADERS += corpusgenerator.h
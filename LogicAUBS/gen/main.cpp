@@ -0,0 +1,107 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+
+#include <cstdio>
+
+#include "proof.h"
+#include "corpusgenerator.h"
+
+/* Exit codes: */
+#define EXIT_GENERATED 0
+#define EXIT_FAILED 1
+#define EXIT_USAGE 2
+
+static bool parseShape(const QString &name, CorpusGenerator::Shape &shape)
+{
+    if (name == "flat")
+        shape = CorpusGenerator::Flat;
+    else if (name == "chain")
+        shape = CorpusGenerator::Chain;
+    else if (name == "tree")
+        shape = CorpusGenerator::Tree;
+    else if (name == "dag")
+        shape = CorpusGenerator::Dag;
+    else
+        return false;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aubs-gen");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes a corpus of synthetic proofs and lemmas, valid or deliberately broken, "
+                                     "and lists the files written with their expected verdict.");
+    parser.addHelpOption();
+    QCommandLineOption seedOption("seed", "Random seed; the same settings and seed give the same corpus.", "n", "1");
+    QCommandLineOption proofsOption("proofs", "Number of proofs.", "n", "10");
+    QCommandLineOption stepsOption("steps", "Steps per proof.", "n", "1000");
+    QCommandLineOption lemmasOption("lemmas", "Number of lemmas.", "n", "0");
+    QCommandLineOption lemmaStepsOption("lemma-steps", "Steps per lemma.", "n", "100");
+    QCommandLineOption depthOption("depth", "Maximum nesting of :Assume scopes.", "n", "4");
+    QCommandLineOption widthOption("width", "Operands of the generated formulas.", "n", "3");
+    QCommandLineOption fanOutOption("fan-out", "Lemma calls per proof or lemma.", "n", "4");
+    QCommandLineOption shapeOption("shape", "Lemma dependencies: flat, chain, tree or dag.", "shape", "dag");
+    QCommandLineOption brokenOption("broken", "Fraction of the proofs with a wrong step.", "fraction", "0");
+    QCommandLineOption binaryOption("binary", "Write binary proof files.");
+    QCommandLineOption checkOption("check", "Verify the files written against their expected verdict.");
+    parser.addOption(seedOption);
+    parser.addOption(proofsOption);
+    parser.addOption(stepsOption);
+    parser.addOption(lemmasOption);
+    parser.addOption(lemmaStepsOption);
+    parser.addOption(depthOption);
+    parser.addOption(widthOption);
+    parser.addOption(fanOutOption);
+    parser.addOption(shapeOption);
+    parser.addOption(brokenOption);
+    parser.addOption(binaryOption);
+    parser.addOption(checkOption);
+    parser.addPositionalArgument("directory", "Directory to write the corpus to.");
+    parser.process(app);
+    QStringList arguments = parser.positionalArguments();
+
+    CorpusGenerator::Settings settings;
+    settings.seed = parser.value(seedOption).toULongLong();
+    settings.proofs = parser.value(proofsOption).toInt();
+    settings.steps = parser.value(stepsOption).toInt();
+    settings.lemmas = parser.value(lemmasOption).toInt();
+    settings.lemmaSteps = parser.value(lemmaStepsOption).toInt();
+    settings.depth = parser.value(depthOption).toInt();
+    settings.width = parser.value(widthOption).toInt();
+    settings.fanOut = parser.value(fanOutOption).toInt();
+    settings.broken = parser.value(brokenOption).toDouble();
+    settings.binary = parser.isSet(binaryOption);
+    if ((arguments.size() != 1) || !parseShape(parser.value(shapeOption), settings.shape) || (settings.proofs < 0)
+            || (settings.steps < 1) || (settings.lemmas < 0) || (settings.lemmaSteps < 1) || (settings.depth < 0)
+            || (settings.width < 1) || (settings.fanOut < 0) || (settings.broken < 0) || (settings.broken > 1)) {
+        fprintf(stderr, "%s", parser.helpText().toLocal8Bit().constData());
+        return EXIT_USAGE;
+    }
+
+    CorpusGenerator generator(settings);
+    if (!generator.generate(arguments[0])) {
+        fprintf(stderr, "%s\n", generator.getLastError().toLocal8Bit().constData());
+        return EXIT_FAILED;
+    }
+    int mismatches = 0;
+    QDir dir(arguments[0]);
+    foreach (const CorpusGenerator::File &file, generator.getFiles()) {
+        printf("%s %d %s", file.name.toLocal8Bit().constData(), file.steps,
+               CorpusGenerator::getDefectName(file.defect).toLocal8Bit().constData());
+        if (file.defectStep >= 0)
+            printf(" %d", file.defectStep);
+        if (parser.isSet(checkOption)) {
+            ProofStream proof(dir.filePath(file.name));
+            bool valid = proof.isCorrect() && proof.isFinished();
+            if (valid != (file.defect == CorpusGenerator::NoDefect)) {
+                printf(" MISMATCH %s", proof.getLastError().toLocal8Bit().constData());
+                ++mismatches;
+            }
+        }
+        printf("\n");
+    }
+    return mismatches ? EXIT_FAILED : EXIT_GENERATED;
+}
@@ -0,0 +1,511 @@
+#include "lemmacache.h"
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QThreadStorage>
+#include <QStringList>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QWeakPointer>
+#include <QSet>
+
+#define CACHE_MAGIC 0x41554243 // "AUBC"
+#define CACHE_VERSION 1
+
+/* Verdict of a proof file, as written to the cache file: */
+struct LemmaCacheRecord
+{
+    qint64 mtime, size;
+    QByteArray contentHash;
+    QList< QPair<QString, QByteArray> > dependencies;
+    LemmaCache::Status status;
+    QString error;
+    QByteArray hash;
+    QString ruleStr;
+};
+
+typedef QSharedPointer<const LemmaCacheRecord> LemmaRecordHandle;
+/* Published entries are never modified (but for checkedEpoch) but replaced, so that they can be read without locking: */
+typedef QSharedPointer<const LemmaCacheEntry> LemmaCacheHandle;
+
+struct LemmaCacheEntry
+{
+    LemmaRecordHandle record;
+    QSharedPointer<Rule> rule;
+    /* The entries of the lemmas it depends on, which stay as long as it does: */
+    QList<LemmaCacheHandle> dependencies;
+    /* Deliberately mutable in an otherwise immutable entry: a hint written atomically, which at worst causes one more check: */
+    mutable QAtomicInt checkedEpoch;
+};
+
+/* The entries are held by the proofs using them, and only weakly by the cache: */
+typedef QHash<QString, QWeakPointer<const LemmaCacheEntry> > LemmaCacheMap;
+
+/* The map a thread is reading, which is not freed meanwhile; slots outlive their threads and are reused: */
+struct LemmaHazard
+{
+    QAtomicPointer<const LemmaCacheMap> map;
+    QAtomicInt used;
+};
+
+/* Gives the slot of the thread back when the thread exits: */
+struct LemmaHazardSlot
+{
+    LemmaHazardSlot() : hazard(NULL) {}
+    ~LemmaHazardSlot()
+    {
+        if (hazard)
+            hazard->used.storeRelease(0);
+    }
+    LemmaHazard *hazard;
+};
+
+/* Never modified but replaced as a whole under lemmaCacheLock, so that readers only load the pointer: */
+static QAtomicPointer<const LemmaCacheMap> lemmaCache;
+static QMutex lemmaCacheLock;
+/* Under lemmaCacheLock: the verdicts of all the proofs checked or read from the cache file, evicted or not: */
+static QHash<QString, LemmaRecordHandle> lemmaRecords;
+/* Under lemmaCacheLock: the slots of all the threads, and the replaced maps which may still be read: */
+static QList<LemmaHazard *> lemmaHazards;
+static QList<const LemmaCacheMap *> retiredMaps;
+static QThreadStorage<LemmaHazardSlot> lemmaHazardSlot;
+/* Canonical paths of the lemmas being loaded by the current thread, outermost first: */
+static QThreadStorage<QStringList> lemmaStack;
+/* Entries checked during the current epoch are trusted without touching the disk again: */
+static QAtomicInt lemmaEpoch;
+/* Under lemmaCacheLock: the thread verifying each lemma, and the lemma each waiting thread waits for: */
+static QHash<QString, QThread *> lemmaLoads;
+static QHash<QThread *, QString> lemmaWaits;
+static QWaitCondition lemmaLoaded;
+
+/* Only locks the first time the thread reads the cache: */
+static LemmaHazard *threadHazard()
+{
+    LemmaHazardSlot &slot = lemmaHazardSlot.localData();
+    if (!slot.hazard) {
+        QMutexLocker locker(&lemmaCacheLock);
+        foreach (LemmaHazard *hazard, lemmaHazards) {
+            if (!hazard->used.loadAcquire()) {
+                slot.hazard = hazard;
+                break;
+            }
+        }
+        if (!slot.hazard) {
+            slot.hazard = new LemmaHazard;
+            lemmaHazards.append(slot.hazard);
+        }
+        slot.hazard->used.store(1);
+    }
+    return slot.hazard;
+}
+
+/* Never locks once the thread has its slot: the map is announced as being read before it is used: */
+static LemmaCacheHandle findEntry(const QString &path)
+{
+    LemmaHazard *hazard = threadHazard();
+    const LemmaCacheMap *map;
+    do {
+        map = lemmaCache.loadAcquire();
+        hazard->map.fetchAndStoreOrdered(map);
+    } while (map != lemmaCache.loadAcquire());
+    LemmaCacheHandle entry = map ? map->value(path).toStrongRef() : LemmaCacheHandle();
+    hazard->map.storeRelease(NULL);
+    return entry;
+}
+
+static LemmaRecordHandle findRecord(const QString &path)
+{
+    QMutexLocker locker(&lemmaCacheLock);
+    return lemmaRecords.value(path);
+}
+
+/* Under lemmaCacheLock: copies the current map without the evicted entries, to be changed and given to replaceMap(): */
+static LemmaCacheMap *copyMap()
+{
+    LemmaCacheMap *map = new LemmaCacheMap;
+    const LemmaCacheMap *current = lemmaCache.load();
+    if (!current)
+        return map;
+    LemmaCacheMap::const_iterator it;
+    for (it = current->constBegin(); it != current->constEnd(); ++it) {
+        if (!it.value().isNull())
+            map->insert(it.key(), it.value());
+    }
+    return map;
+}
+
+/* Under lemmaCacheLock: publishes the map, and frees the replaced ones that no thread is reading: */
+static void replaceMap(LemmaCacheMap *map)
+{
+    const LemmaCacheMap *old = lemmaCache.fetchAndStoreOrdered(map);
+    if (old)
+        retiredMaps.append(old);
+    QSet<const LemmaCacheMap *> read;
+    foreach (LemmaHazard *hazard, lemmaHazards)
+        read.insert(hazard->map.loadAcquire());
+    for (int i = retiredMaps.size(); i-- > 0;) {
+        if (!read.contains(retiredMaps[i])) {
+            delete retiredMaps[i];
+            retiredMaps.removeAt(i);
+        }
+    }
+}
+
+static void publishEntry(const QString &path, const LemmaCacheHandle &entry)
+{
+    QMutexLocker locker(&lemmaCacheLock);
+    LemmaCacheMap *map = copyMap();
+    map->insert(path, entry);
+    lemmaRecords.insert(path, entry->record);
+    replaceMap(map);
+}
+
+static LemmaCacheHandle makeEntry(const LemmaRecordHandle &record, const QSharedPointer<Rule> &rule,
+                                  const QList<LemmaCacheHandle> &dependencies, int epoch)
+{
+    LemmaCacheEntry *entry = new LemmaCacheEntry;
+    entry->record = record;
+    entry->rule = rule;
+    entry->dependencies = dependencies;
+    entry->checkedEpoch.store(epoch);
+    return LemmaCacheHandle(entry);
+}
+
+/*
+ * Returns false if the record is stale, and otherwise gets the entries of the lemmas it depends on;
+ * touched is set if only the file date changed:
+ */
+static bool checkRecord(const QString &path, const QFileInfo &info, const LemmaCacheRecord &record,
+                        bool &touched, QList<LemmaCacheHandle> &dependencies)
+{
+    touched = (info.lastModified().toMSecsSinceEpoch() != record.mtime) || (info.size() != record.size);
+    if (touched && (LemmaCache::contentHash(path) != record.contentHash))
+        return false;
+    QStringList &stack = lemmaStack.localData();
+    stack.append(path);
+    bool fresh = true;
+    for (int i = 0; fresh && (i < record.dependencies.size()); ++i) {
+        LemmaCache::Lemma lemma = LemmaCache::get(record.dependencies[i].first);
+        fresh = (lemma.hash == record.dependencies[i].second);
+        if (!lemma.entry.isNull())
+            dependencies.append(lemma.entry);
+    }
+    stack.removeLast();
+    return fresh;
+}
+
+static LemmaRecordHandle touchRecord(const LemmaRecordHandle &record, const QFileInfo &info)
+{
+    LemmaCacheRecord *touched = new LemmaCacheRecord(*record);
+    touched->mtime = info.lastModified().toMSecsSinceEpoch();
+    touched->size = info.size();
+    return LemmaRecordHandle(touched);
+}
+
+/* Entry of a record still holding, whose rule is parsed again, or a null handle: */
+static LemmaCacheHandle reviveEntry(const QString &path, const QFileInfo &info, const LemmaRecordHandle &record, int epoch)
+{
+    bool touched;
+    QList<LemmaCacheHandle> dependencies;
+    if (!checkRecord(path, info, *record, touched, dependencies))
+        return LemmaCacheHandle();
+    QSharedPointer<Rule> rule;
+    if (record->status == LemmaCache::Verified) {
+        rule = QSharedPointer<Rule>(Rule::fromStr(record->ruleStr));
+        if (rule.isNull())
+            return LemmaCacheHandle();
+    }
+    return makeEntry(touched ? touchRecord(record, info) : record, rule, dependencies, epoch);
+}
+
+/* Returns false after waiting for another thread to load the lemma, in which case its entry is looked up again;
+   owner is set if this thread must load it and then call endLoad(): */
+static bool beginLoad(const QString &path, bool &owner)
+{
+    QThread *self = QThread::currentThread();
+    QMutexLocker locker(&lemmaCacheLock);
+    owner = false;
+    QThread *loader = lemmaLoads.value(path, NULL);
+    if (!loader) {
+        lemmaLoads.insert(path, self);
+        owner = true;
+        return true;
+    }
+    /* Waiting for a thread which waits for this one means a lemma cycle across threads, which loading here reports: */
+    for (QThread *thread = loader; thread; thread = lemmaLoads.value(lemmaWaits.value(thread), NULL)) {
+        if (thread == self)
+            return true;
+    }
+    lemmaWaits.insert(self, path);
+    while (lemmaLoads.contains(path))
+        lemmaLoaded.wait(&lemmaCacheLock);
+    lemmaWaits.remove(self);
+    return false;
+}
+
+static void endLoad(const QString &path)
+{
+    QMutexLocker locker(&lemmaCacheLock);
+    lemmaLoads.remove(path);
+    lemmaLoaded.wakeAll();
+}
+
+static LemmaCacheHandle loadEntry(const QString &path, const QFileInfo &info, int epoch)
+{
+    LemmaCacheRecord *record = new LemmaCacheRecord;
+    LemmaRecordHandle handle(record);
+    record->mtime = info.lastModified().toMSecsSinceEpoch();
+    record->size = info.size();
+    record->contentHash = LemmaCache::contentHash(path);
+    QList<LemmaCacheHandle> dependencies;
+    QStringList &stack = lemmaStack.localData();
+    stack.append(path);
+    ProofStream proof(path);
+    foreach (const QString &dependency, proof.getLemmas()) {
+        LemmaCache::Lemma lemma = LemmaCache::get(dependency);
+        record->dependencies.append(qMakePair(dependency, lemma.hash));
+        if (!lemma.entry.isNull())
+            dependencies.append(lemma.entry);
+    }
+    stack.removeLast();
+    QCryptographicHash chain(QCryptographicHash::Sha1);
+    chain.addData(record->contentHash);
+    for (int i = 0; i < record->dependencies.size(); ++i)
+        chain.addData(record->dependencies[i].second);
+    record->hash = chain.result();
+    QSharedPointer<Rule> rule;
+    if (!proof.isCorrect()) {
+        record->status = LemmaCache::Incorrect;
+        record->error = QObject::tr("Lemma \"%1\" is not correct.").arg(path);
+        if (!proof.getLastError().isEmpty())
+            record->error += QStringLiteral(" ") + proof.getLastError();
+    } else if (!proof.isFinished()) {
+        record->status = LemmaCache::Unfinished;
+        record->error = QObject::tr("Lemma \"%1\" is not finished.").arg(path);
+    } else {
+        record->status = LemmaCache::Verified;
+        rule = proof.getRule();
+        record->ruleStr = rule->getStr();
+    }
+    return makeEntry(handle, rule, dependencies, epoch);
+}
+
+static LemmaCache::Lemma makeLemma(const LemmaCacheHandle &entry)
+{
+    LemmaCache::Lemma result;
+    result.status = entry->record->status;
+    result.error = entry->record->error;
+    result.hash = entry->record->hash;
+    result.rule = entry->rule;
+    result.entry = entry;
+    return result;
+}
+
+LemmaCache::Lemma LemmaCache::get(const QString &filename)
+{
+    Lemma result;
+    QFileInfo info(filename);
+    QString path = info.canonicalFilePath();
+    if (path.isEmpty() || !info.isFile()) {
+        result.status = NotFound;
+        result.error = QObject::tr("Lemma \"%1\" is not found.").arg(filename);
+        return result;
+    }
+    QStringList &stack = lemmaStack.localData();
+    int cycleStart = stack.indexOf(path);
+    if (cycleStart >= 0) {
+        QStringList cycle = stack.mid(cycleStart);
+        cycle.append(path);
+        result.status = Cyclic;
+        result.error = QObject::tr("Lemma \"%1\" depends on itself (%2).").arg(filename, cycle.join(" -> "));
+        return result;
+    }
+    int epoch = lemmaEpoch.load();
+    bool owner;
+    LemmaRecordHandle stale;
+    do {
+        LemmaCacheHandle entry = findEntry(path);
+        if (entry.isNull())
+            continue;
+        if (entry->checkedEpoch.load() == epoch)
+            return makeLemma(entry);
+        bool touched;
+        QList<LemmaCacheHandle> dependencies;
+        if (!checkRecord(path, info, *entry->record, touched, dependencies)) {
+            stale = entry->record;
+            continue;
+        }
+        if (touched) {
+            entry = makeEntry(touchRecord(entry->record, info), entry->rule, dependencies, epoch);
+            publishEntry(path, entry);
+        } else {
+            entry->checkedEpoch.store(epoch);
+        }
+        return makeLemma(entry);
+    } while (!beginLoad(path, owner));
+    /* An evicted entry leaves its record, from which only the rule is parsed again: */
+    LemmaCacheHandle entry;
+    LemmaRecordHandle record = findRecord(path);
+    if (!record.isNull() && (record != stale))
+        entry = reviveEntry(path, info, record, epoch);
+    if (entry.isNull())
+        entry = loadEntry(path, info, epoch);
+    publishEntry(path, entry);
+    if (owner)
+        endLoad(path);
+    return makeLemma(entry);
+}
+
+/* Neither reads the file nor checks the lemmas again, but compares the hashes of the cache: */
+bool LemmaCache::getDependencies(const QString &filename, QStringList &dependencies)
+{
+    QFileInfo info(filename);
+    QString path = info.canonicalFilePath();
+    if (path.isEmpty())
+        return false;
+    LemmaRecordHandle record = findRecord(path);
+    if (record.isNull() || (info.lastModified().toMSecsSinceEpoch() != record->mtime) || (info.size() != record->size))
+        return false;
+    QStringList result;
+    for (int i = 0; i < record->dependencies.size(); ++i) {
+        LemmaRecordHandle dependency = findRecord(QFileInfo(record->dependencies[i].first).canonicalFilePath());
+        if (dependency.isNull() || (dependency->hash != record->dependencies[i].second))
+            return false;
+        result.append(record->dependencies[i].first);
+    }
+    dependencies = result;
+    return true;
+}
+
+void LemmaCache::invalidate(const QString &filename)
+{
+    QString path = QFileInfo(filename).canonicalFilePath();
+    QMutexLocker locker(&lemmaCacheLock);
+    LemmaCacheMap *map = copyMap();
+    map->remove(path.isEmpty() ? filename : path);
+    lemmaRecords.remove(path.isEmpty() ? filename : path);
+    replaceMap(map);
+}
+
+void LemmaCache::clear()
+{
+    QMutexLocker locker(&lemmaCacheLock);
+    lemmaRecords.clear();
+    replaceMap(new LemmaCacheMap);
+}
+
+void LemmaCache::refresh()
+{
+    lemmaEpoch.ref();
+}
+
+bool LemmaCache::load(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    if ((magic != CACHE_MAGIC) || (version != CACHE_VERSION)) {
+        file.close();
+        return false;
+    }
+    QHash<QString, LemmaRecordHandle> records;
+    records.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        QString path;
+        quint32 status, n;
+        LemmaCacheRecord *record = new LemmaCacheRecord;
+        LemmaRecordHandle handle(record);
+        in >> path >> record->mtime >> record->size >> record->contentHash >> n;
+        for (quint32 j = 0; j < n; ++j) {
+            QPair<QString, QByteArray> dependency;
+            in >> dependency.first >> dependency.second;
+            record->dependencies.append(dependency);
+        }
+        in >> status >> record->error >> record->hash >> record->ruleStr;
+        if ((in.status() != QDataStream::Ok) || (status > Cyclic)) {
+            file.close();
+            return false;
+        }
+        /* The rules are parsed when the lemmas are first used: */
+        record->status = Status(status);
+        records.insert(path, handle);
+    }
+    file.close();
+    QMutexLocker locker(&lemmaCacheLock);
+    QHash<QString, LemmaRecordHandle>::const_iterator it = records.constBegin();
+    while (it != records.constEnd()) {
+        if (!lemmaRecords.contains(it.key()))
+            lemmaRecords.insert(it.key(), it.value());
+        ++it;
+    }
+    return true;
+}
+
+bool LemmaCache::save(const QString &cacheFile)
+{
+    QFileInfo info(cacheFile);
+    if (!QDir().mkpath(info.absolutePath()))
+        return false;
+    lemmaCacheLock.lock();
+    QHash<QString, LemmaRecordHandle> records = lemmaRecords;
+    lemmaCacheLock.unlock();
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION) << quint32(records.size());
+    QHash<QString, LemmaRecordHandle>::const_iterator it = records.constBegin();
+    while (it != records.constEnd()) {
+        const LemmaCacheRecord &record = *it.value();
+        out << it.key() << record.mtime << record.size << record.contentHash << quint32(record.dependencies.size());
+        for (int j = 0; j < record.dependencies.size(); ++j)
+            out << record.dependencies[j].first << record.dependencies[j].second;
+        out << quint32(record.status) << record.error << record.hash << record.ruleStr;
+        ++it;
+    }
+    return file.commit();
+}
+
+QString LemmaCache::defaultCacheFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/verification.cache");
+}
+
+QString LemmaCache::resolve(const QString &name, const QString &baseDir)
+{
+    if (!baseDir.isEmpty() && QFileInfo(name).isRelative()) {
+        QString candidate = QDir(baseDir).filePath(name);
+        if (QFileInfo(candidate).exists())
+            return candidate;
+    }
+    return name;
+}
+
+QByteArray LemmaCache::contentHash(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    file.close();
+    return hash.result();
+}
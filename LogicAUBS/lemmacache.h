@@ -0,0 +1,58 @@
+#ifndef LEMMACACHE_H
+#define LEMMACACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "proof.h"
+
+/*
+ * Process-wide cache of lemma files. A lemma is verified once and its rule is
+ * reused as long as neither the file (compared by mtime/size, then by content
+ * hash) nor any of the lemmas it depends on has changed.
+ * Any proof file can be checked through get(); the verdicts can be saved to
+ * and restored from a cache file so that unchanged proofs are not verified
+ * again in a later session.
+ * All the proofs, whichever window or thread they belong to, share the entry
+ * of a lemma, with its rule: each proof holds the entries of the lemmas it
+ * uses (and each entry those of its own lemmas), and the cache only keeps a
+ * weak reference to them, so that an entry is evicted once no open proof
+ * references it. Its verdict stays, as in the cache file, so that the lemma
+ * is not verified again when it is next used; only its rule is parsed again.
+ * Lookups do not lock: writers replace the whole map of the cache,
+ * and readers announce the map they read (hazard pointers) so that it is not
+ * freed under them. A thread missing a lemma which another thread is
+ * verifying waits for its verdict instead of verifying it too.
+ */
+class LemmaCache
+{
+public:
+    enum Status { Verified, NotFound, Incorrect, Unfinished, Cyclic };
+    struct Lemma
+    {
+        Status status;
+        QSharedPointer<Rule> rule;
+        QString error;
+        QByteArray hash;
+        /* Keeps the lemma in the cache as long as it is held: */
+        QSharedPointer<const LemmaCacheEntry> entry;
+    };
+public:
+    static Lemma get(const QString &filename);
+    /* Lemmas of a cached proof, unless the file or the hash of one of them changed: */
+    static bool getDependencies(const QString &filename, QStringList &dependencies);
+    static void invalidate(const QString &filename);
+    static void clear();
+    /* Starts a new batch of verifications, in which the lemmas are checked against their files again, once each;
+       a process starts in its first batch: */
+    static void refresh();
+    static bool load(const QString &cacheFile);
+    static bool save(const QString &cacheFile);
+    static QString defaultCacheFile();
+    static QString resolve(const QString &name, const QString &baseDir);
+    static QByteArray contentHash(const QString &filename);
+};
+
+#endif // LEMMACACHE_H
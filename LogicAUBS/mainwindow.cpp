@@ -1,5 +1,6 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "lemmacache.h"
 
 #include <QMessageBox>
 #include <QFileDialog>
@@ -8,6 +9,7 @@
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    pool = new VerificationPool(this);
 #ifdef Q_OS_LINUX
     /* Prevent the Ubuntu bug with the shortcuts not working with appmenu-qt5: */
     addActions(ui->menuBar->actions());
@@ -15,10 +17,14 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     /* No shortcut overload with MdiArea: */
     ui->actionClose->setShortcutContext(Qt::WidgetShortcut);
     noWindow();
+    LemmaCache::load(LemmaCache::defaultCacheFile());
 }
 
 MainWindow::~MainWindow()
 {
+    /* No lemma may be verified while the cache is saved: */
+    pool->cancelAll();
+    LemmaCache::save(LemmaCache::defaultCacheFile());
     delete ui;
 }
 
@@ -91,7 +97,7 @@ void MainWindow::on_actionExit_triggered()
 
 void MainWindow::on_actionNew_proof_triggered()
 {
-    addWindow(new ProofWindow(ui->mdiArea));
+    addWindow(new ProofWindow(pool, ui->mdiArea));
 }
 
 void MainWindow::on_actionClose_triggered()
@@ -101,8 +107,8 @@ void MainWindow::on_actionClose_triggered()
 
 void MainWindow::on_actionOpen_triggered()
 {
-    QString filename = QFileDialog::getOpenFileName(this, tr("Select proof file"), QString(), tr("Proof files (*.aubs)"));
+    QString filename = QFileDialog::getOpenFileName(this, tr("Select proof file"), QString(), tr("Proof files (*.aubs *.aubsb)"));
     if (filename.isEmpty())
         return;
-    addWindow(new ProofWindow(ui->mdiArea, filename));
+    addWindow(new ProofWindow(pool, ui->mdiArea, filename));
 }
@@ -5,6 +5,7 @@
 #include <QList>
 
 #include "proofwindow.h"
+#include "verificationpool.h"
 
 namespace Ui {
 class MainWindow;
@@ -32,6 +33,8 @@ private slots:
     void on_actionOpen_triggered();
 private:
     Ui::MainWindow *ui;
+    /* Verifies the proofs of all the windows: */
+    VerificationPool *pool;
 };
 
 #endif // MAINWINDOW_H
@@ -1,571 +1,2089 @@
 #include "proof.h"
+#include "lemmacache.h"
+#include "binaryproof.h"
 
 #include <QStringList>
 #include <QMap>
+#include <QHash>
 #include <QMutex>
 #include <QObject>
 #include <QFile>
+#include <QFileInfo>
 #include <QTextStream>
+#include <QtAlgorithms>
+#include <QThreadStorage>
 
-static QMap<QString, QSharedPointer<Rule> > basicRules;
-static QMutex basicRulesLock;
+#include <climits>
+#include <cstring>
+#include <new>
 
-QString Expression::getLevelCompliantStr(int maxLevel, bool bracketized) const
+#if defined(AUBS_PROFILE)
+#include <QElapsedTimer>
+#endif
+
+struct BasicRuleInfo
 {
-    if (getLevel() <= maxLevel)
-        return getStr(bracketized);
-    return QStringLiteral("(") + getStr(bracketized) + QStringLiteral(")");
+    const char *name, *rule;
+};
+
+/* Indexed by BasicRule; ":Assume", ":IntroArrow" and ":RAA" are also handled separately for correctness: */
+static const BasicRuleInfo basicRuleInfo[] = {
+    { ":ElimAnd", "X&Y : X, Y" },
+    { ":IntroAnd", "X, Y : X&Y" },
+    { ":ElimOr1", "X|Y, ~X : Y" },
+    { ":ElimOr2", "X|Y, ~Y : X" },
+    { ":IntroOr", "X : X|Y, Y|X" },
+    { ":ElimArrow", "X, X>Y : Y" },
+    { ":Assume", ": X" },
+    { ":IntroArrow", "Y : X>Y" },
+    { ":RAA", "Y, ~Y : X" },
+    { ":ElimEquiv", "X=Y : X>Y, Y>X" },
+    { ":IntroEquiv", "X>Y, Y>X : X=Y" },
+    { ":Conclusion", "X : X" }
+};
+Q_STATIC_ASSERT(sizeof(basicRuleInfo) / sizeof(basicRuleInfo[0]) == BasicRuleCount);
+
+/* Steps checked between two reports to a VerificationObserver: */
+#define VERIFICATION_PROGRESS_STEPS 1024
+
+/* Steps of lemmas are counted together in the time per rule: */
+#define PROFILE_LEMMA_RULE "(lemmas)"
+
+/*
+ * Profiling hooks, compiled out unless AUBS_PROFILE is defined. PROFILE()
+ * wraps statements on the profile of a proof, from its own methods, and
+ * PROFILE_COUNT() adds to the profile of the proof the current thread is
+ * loading or verifying, from code that does not know about proofs.
+ */
+#if defined(AUBS_PROFILE)
+/* Profiles of the proofs being loaded or verified by the current thread, innermost last: */
+static QThreadStorage<QVector<ProofProfile *> > profileStack;
+
+class ProfileScope
+{
+public:
+    ProfileScope(ProofProfile *profile)
+    {
+        profileStack.localData().append(profile);
+    }
+    ~ProfileScope()
+    {
+        profileStack.localData().removeLast();
+    }
+};
+
+static inline ProofProfile *currentProfile()
+{
+    const QVector<ProofProfile *> &stack = profileStack.localData();
+    return stack.isEmpty() ? NULL : stack.last();
 }
 
-Expression *Expression::fromStr(const QString &str)
+#define PROFILE(...) __VA_ARGS__
+#define PROFILE_SCOPE() ProfileScope profileScope(&profile)
+#define PROFILE_COUNT(counter, value) \
+    do { ProofProfile *current = currentProfile(); if (current) current->counter += (value); } while (false)
+#else
+#define PROFILE(...)
+#define PROFILE_SCOPE()
+#define PROFILE_COUNT(counter, value) do {} while (false)
+#endif
+
+struct ExprKey
 {
-    int end;
-    Expression *result = fromStrAux(str, 0, 3, end);
-    if (end != str.length())
-        return NULL;
-    return result;
+    Expression::Kind kind;
+    const Expression *e1, *e2;
+};
+
+static inline bool operator==(const ExprKey &a, const ExprKey &b)
+{
+    return (a.kind == b.kind) && (a.e1 == b.e1) && (a.e2 == b.e2);
 }
 
-Expression *Expression::fromStrAux(const QString &str, int start, int maxLevel, int &end)
-{
-    if (maxLevel >= 2) {
-        if (maxLevel >= 3) {
-            Expression *e1 = fromStrAux(str, start, 2, end);
-            if (!e1)
-                return NULL;
-            if ((end >= str.length()) || ((str[end] != '>') && (str[end] != '=')))
-                return e1;
-            char mem = str[end].toLatin1();
-            Expression *e2 = fromStrAux(str, ++end, 2, end);
-            if (!e2)
-                return NULL;
-            if (mem == '=')
-                return new ExprEquiv(e1, e2);
-            return new ExprImply(e1, e2);
-        }
-        Expression *e1 = fromStrAux(str, start, 1, end);
-        if (!e1)
-            return NULL;
-        if ((end >= str.length()) || ((str[end] != '|') && (str[end] != '&')))
-            return e1;
-        char mem = str[end].toLatin1();
-        Expression *e2 = fromStrAux(str, ++end, 1, end);
-        if (!e2)
-            return NULL;
-        if (mem == '|')
-            return new ExprOR(e1, e2);
-        return new ExprAND(e1, e2);
-    }
-    if (start >= str.length())
-        return NULL;
-    if (maxLevel >= 1) {
-        int mid = start;
-        while (str[mid] == '~') {
-            if (++mid >= str.length())
-                return NULL;
-        }
-        Expression *result = fromStrAux(str, mid, 0, end);
-        while (start < mid) {
-            result = new ExprNOT(result);
-            ++start;
+static inline uint qHash(const ExprKey &key, uint seed = 0)
+{
+    return qHash(key.e1, seed) ^ (qHash(key.e2, seed) * 31) ^ (uint(key.kind) * 0x9E3779B9u);
+}
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 8
+
+/* Nodes are never freed one by one, so they are carved out of large chunks that are kept until exit: */
+class ExprArena
+{
+public:
+    ExprArena() : current(NULL), left(0), used(0), reserved(0) {}
+    void *allocate(size_t size)
+    {
+        size = (size + ARENA_ALIGNMENT - 1) & ~size_t(ARENA_ALIGNMENT - 1);
+        if (size > left) {
+            left = qMax(size, size_t(ARENA_CHUNK_SIZE));
+            current = static_cast<char *>(::operator new(left));
+            reserved += left;
         }
+        void *result = current;
+        current += size;
+        left -= size;
+        used += size;
         return result;
     }
-    if (str[start] == '(') {
-        Expression *e = fromStrAux(str, start + 1, 3, end);
-        if ((end >= str.length()) || (str[end] != ')'))
-            return NULL;
-        ++end;
-        return e;
-    }
-    end = start;
-    while ((end < str.length()) && str[end].isLetter())
-        ++end;
-    if (end == start)
-        return NULL;
-    return new ExprVar(str.mid(start, end - start));
+public:
+    char *current;
+    size_t left;
+    qint64 used, reserved;
+};
+
+static QHash<QString, const Expression *> varTable;
+static QVector<const ExprVar *> varById;
+static QHash<ExprKey, const Expression *> exprTable;
+static ExprArena exprArena;
+static QMutex exprTableLock;
+/* Variables are never removed nor renumbered, so that each thread keeps those it looked up, and only locks for new ones: */
+static QThreadStorage<QHash<QString, const ExprVar *> > knownVarNames;
+static QThreadStorage<QVector<const ExprVar *> > knownVarIds;
+
+static inline uint combineHash(Expression::Kind kind, const Expression *e1, const Expression *e2 = NULL)
+{
+    uint h = uint(kind) * 0x9E3779B9u;
+    h ^= e1->getHash() + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    if (e2)
+        h ^= e2->getHash() + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    return h;
 }
 
-ExprVar::ExprVar(QString variableName) : varName(variableName)
+/* Binding level of each kind, as given by getLevel(); connectives of a level do not chain: */
+static const int kindLevel[] = { 0, 1, 2, 2, 3, 3 };
+
+/* Operands of a flattened chain, last first; nodes of the chain use a prefix of the items: */
+struct OperandBlock
 {
-    for (int i = variableName.length(); i-- > 0;) {
-        if (!variableName[i].isLetter()) {
-            varName = "?";
-            return;
-        }
-    }
+    int used, capacity;
+    const Expression *items[1];
+};
+
+#define OPERAND_BLOCK_MIN_CAPACITY 8
+
+static OperandBlock *allocateOperandBlock(int capacity)
+{
+    OperandBlock *block = static_cast<OperandBlock *>(exprArena.allocate(sizeof(OperandBlock) + (capacity - 1) * sizeof(const Expression *)));
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
 }
 
-QString ExprVar::getStr(bool bracketized) const
+/* Variables of a node are not stored but collected on demand if their identifiers go beyond: */
+#define VARSET_MAX_STORED_CAPACITY 1024
+
+VarSet::VarSet() : low(0) {}
+
+bool VarSet::isEmpty() const
 {
-    if (bracketized)
-        return QStringLiteral("[") + varName + QStringLiteral("]");
-    return varName;
+    return !low && high.isEmpty();
 }
 
-QSet<QString> ExprVar::getVariables() const
+int VarSet::count() const
 {
-    QSet<QString> result;
-    result.insert(varName);
+    int result = qPopulationCount(low);
+    foreach (quint64 word, high)
+        result += qPopulationCount(word);
     return result;
 }
 
-Expression *ExprVar::getCopy() const
+int VarSet::getCapacity() const
 {
-    return new ExprVar(varName);
+    return 64 * (high.size() + 1);
 }
 
-QSharedPointer<Expression> ExprVar::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const
+bool VarSet::contains(int id) const
 {
-    return renaming.value(varName);
+    if (id < 64)
+        return (low >> id) & 1;
+    int word = id / 64 - 1;
+    return (word < high.size()) && ((high[word] >> (id % 64)) & 1);
 }
 
-int ExprVar::getLevel() const
+bool VarSet::contains(const VarSet &other) const
 {
-    return 0;
+    if ((other.low & ~low) || (other.high.size() > high.size()))
+        return false;
+    for (int i = 0; i < other.high.size(); ++i) {
+        if (other.high[i] & ~high[i])
+            return false;
+    }
+    return true;
 }
 
-ExprNOT::ExprNOT(Expression *e) : e(e) {}
+bool VarSet::intersects(const VarSet &other) const
+{
+    if (low & other.low)
+        return true;
+    for (int i = qMin(high.size(), other.high.size()); i-- > 0;) {
+        if (high[i] & other.high[i])
+            return true;
+    }
+    return false;
+}
 
-QString ExprNOT::getStr(bool bracketized) const
+void VarSet::insert(int id)
 {
-    return QStringLiteral("~") + e->getLevelCompliantStr(1, bracketized);
+    if (id < 64) {
+        low |= quint64(1) << id;
+        return;
+    }
+    int word = id / 64 - 1;
+    if (word >= high.size())
+        high.resize(word + 1);
+    high[word] |= quint64(1) << (id % 64);
 }
 
-QSet<QString> ExprNOT::getVariables() const
+QList<int> VarSet::getIds() const
 {
-    return e->getVariables();
+    QList<int> result;
+    for (int i = -1; i < high.size(); ++i) {
+        quint64 word = (i < 0) ? low : high[i];
+        while (word) {
+            result.append((i + 1) * 64 + qCountTrailingZeroBits(word));
+            word &= word - 1;
+        }
+    }
+    return result;
 }
 
-Expression *ExprNOT::getCopy() const
+QSet<QString> VarSet::getNames() const
 {
-    return new ExprNOT(e->getCopy());
+    QList<int> ids = getIds();
+    QSet<QString> result;
+    result.reserve(ids.size());
+    QMutexLocker locker(&exprTableLock);
+    foreach (int id, ids)
+        result.insert(varById[id]->getName());
+    return result;
 }
 
-QSharedPointer<Expression> ExprNOT::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming)
+/* A union that adds nothing keeps sharing the words of one of the operands: */
+VarSet &VarSet::operator|=(const VarSet &other)
 {
-    e->replaceVariableNames(renaming);
+    if (contains(other))
+        return *this;
+    if (other.contains(*this))
+        return *this = other;
+    low |= other.low;
+    if (high.size() < other.high.size())
+        high.resize(other.high.size());
+    for (int i = 0; i < other.high.size(); ++i)
+        high[i] |= other.high[i];
+    return *this;
 }
 
-int ExprNOT::getLevel() const
+VarSet VarSet::operator|(const VarSet &other) const
 {
-    return 1;
+    VarSet result = *this;
+    result |= other;
+    return result;
 }
 
-ExprOR::ExprOR(Expression *e1, Expression *e2) : e1(e1), e2(e2) {}
+bool VarSet::operator==(const VarSet &other) const
+{
+    return (low == other.low) && (high == other.high);
+}
 
-QString ExprOR::getStr(bool bracketized) const
+bool VarSet::operator!=(const VarSet &other) const
 {
-    return e1->getLevelCompliantStr(1, bracketized) + QStringLiteral("|") + e2->getLevelCompliantStr(1, bracketized);
+    return !(*this == other);
 }
 
-QSet<QString> ExprOR::getVariables() const
+Expression::Expression(Kind kind, uint hash, const Expression *e1, const Expression *e2)
+    : kind(kind), hash(hash), strCache(NULL), variablesStored(true)
 {
-    return e1->getVariables() | e2->getVariables();
+    if (!e1)
+        return;
+    if (!e1->variablesStored || (e2 && !e2->variablesStored)) {
+        variablesStored = false;
+        return;
+    }
+    variables = e1->variables;
+    if (e2)
+        variables |= e2->variables;
+    if (variables.getCapacity() > VARSET_MAX_STORED_CAPACITY) {
+        variables = VarSet();
+        variablesStored = false;
+    }
 }
 
-Expression *ExprOR::getCopy() const
+Expression::Kind Expression::getKind() const
 {
-    return new ExprOR(e1->getCopy(), e2->getCopy());
+    return kind;
 }
 
-void ExprOR::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming)
+uint Expression::getHash() const
 {
-    e1->replaceVariableNames(renaming);
-    e2->replaceVariableNames(renaming);
+    return hash;
 }
 
-int ExprOR::getLevel() const
+int Expression::getChildCount() const
 {
-    return 2;
+    switch (kind) {
+    case Variable:
+        return 0;
+    case NOT:
+        return 1;
+    default:
+        return 2;
+    }
 }
 
-ExprAND::ExprAND(Expression *e1, Expression *e2) : e1(e1), e2(e2) {}
+const Expression *Expression::getChild(int) const
+{
+    return NULL;
+}
 
-QString ExprAND::getStr(bool bracketized) const
+QString Expression::getLevelCompliantStr(int maxLevel, bool bracketized) const
 {
-    return e1->getLevelCompliantStr(1, bracketized) + QStringLiteral("&") + e2->getLevelCompliantStr(1, bracketized);
+    if (getLevel() <= maxLevel)
+        return getStr(bracketized);
+    int length = serialize(this, bracketized, NULL);
+    QString result(length + 2, Qt::Uninitialized);
+    result[0] = QLatin1Char('(');
+    serialize(this, bracketized, result.data() + 1);
+    result[length + 1] = QLatin1Char(')');
+    return result;
 }
 
-QSet<QString> ExprAND::getVariables() const
+int Expression::getOperandCount() const
 {
-    return e1->getVariables() | e2->getVariables();
+    if ((kind == OR) || (kind == AND))
+        return static_cast<const ExprNary *>(this)->count;
+    return getChildCount();
 }
 
-Expression *ExprAND::getCopy() const
+const Expression *Expression::getOperand(int index) const
 {
-    return new ExprAND(e1->getCopy(), e2->getCopy());
+    if ((kind != OR) && (kind != AND))
+        return getChild(index);
+    const ExprNary *chain = static_cast<const ExprNary *>(this);
+    if (!index)
+        return chain->head;
+    if (!chain->block)
+        return chain->tail;
+    return chain->block->items[chain->count - 1 - index];
 }
 
-void ExprAND::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming)
+int Expression::getLevel() const
 {
-    e1->replaceVariableNames(renaming);
-    e2->replaceVariableNames(renaming);
+    return kindLevel[kind];
 }
 
-int ExprAND::getLevel() const
+/* Texts longer than this are not kept, so that the cache stays proportional to what was written: */
+#define STR_CACHE_MAX_LENGTH 65536
+
+/* Canonical text of a node, kept once the node has been written out as a whole: */
+struct ExprText
+{
+    QString text;
+    uint hash;
+};
+
+/* Output still to be written, last first: an expression within a maximum level, or a symbol: */
+struct StrItem
+{
+    const Expression *e;
+    int maxLevel;
+    char symbol;
+};
+
+static inline void pushStr(QVector<StrItem> &stack, const Expression *e, int maxLevel, char symbol = 0)
 {
-    return 2;
+    StrItem item;
+    item.e = e;
+    item.maxLevel = maxLevel;
+    item.symbol = symbol;
+    stack.append(item);
 }
 
-ExprImply::ExprImply(Expression *e1, Expression *e2) : e1(e1), e2(e2) {}
+static inline void writeChars(QChar *out, int &length, const QChar *chars, int count)
+{
+    if (out)
+        memcpy(out + length, chars, count * sizeof(QChar));
+    length += count;
+}
 
-QString ExprImply::getStr(bool bracketized) const
+static inline void writeSymbol(QChar *out, int &length, char symbol)
 {
-    return e1->getLevelCompliantStr(2, bracketized) + QStringLiteral(">") + e2->getLevelCompliantStr(2, bracketized);
+    if (out)
+        out[length] = QLatin1Char(symbol);
+    ++length;
 }
 
-QSet<QString> ExprImply::getVariables() const
+/*
+ * Writes the text of an expression to out in a single pass, or only measures it
+ * when out is NULL, and returns its length. Subexpressions whose canonical text
+ * is cached are copied instead of walked.
+ */
+int Expression::serialize(const Expression *root, bool bracketized, QChar *out)
 {
-    return e1->getVariables() | e2->getVariables();
+    static const char symbols[] = { 0, '~', '|', '&', '>', '=' };
+    int length = 0;
+    QVector<StrItem> stack;
+    pushStr(stack, root, kindLevel[Equiv]);
+    while (!stack.isEmpty()) {
+        StrItem item = stack.takeLast();
+        if (item.symbol) {
+            writeSymbol(out, length, item.symbol);
+            continue;
+        }
+        const Expression *e = item.e;
+        if (e->getLevel() > item.maxLevel) {
+            pushStr(stack, NULL, 0, ')');
+            pushStr(stack, e, e->getLevel());
+            pushStr(stack, NULL, 0, '(');
+            continue;
+        }
+        const ExprText *cached = bracketized ? NULL : e->strCache.loadAcquire();
+        if (cached) {
+            writeChars(out, length, cached->text.constData(), cached->text.length());
+            continue;
+        }
+        switch (e->kind) {
+        case Variable:
+        {
+            const QString &name = static_cast<const ExprVar *>(e)->getName();
+            if (bracketized)
+                writeSymbol(out, length, '[');
+            writeChars(out, length, name.constData(), name.length());
+            if (bracketized)
+                writeSymbol(out, length, ']');
+            break;
+        }
+        case NOT:
+            pushStr(stack, e->getChild(0), 1);
+            pushStr(stack, NULL, 0, symbols[NOT]);
+            break;
+        case OR:
+        case AND:
+        {
+            /* x1&(x2&(...&(xm&xn))), pushed from the end: */
+            int n = e->getOperandCount();
+            for (int i = n - 2; i > 0; --i)
+                pushStr(stack, NULL, 0, ')');
+            pushStr(stack, e->getOperand(n - 1), 1);
+            for (int i = n - 1; i-- > 0;) {
+                if (i < n - 2)
+                    pushStr(stack, NULL, 0, '(');
+                pushStr(stack, NULL, 0, symbols[e->kind]);
+                pushStr(stack, e->getOperand(i), 1);
+            }
+            break;
+        }
+        default:
+            pushStr(stack, e->getChild(1), 2);
+            pushStr(stack, NULL, 0, symbols[e->kind]);
+            pushStr(stack, e->getChild(0), 2);
+            break;
+        }
+    }
+    PROFILE_COUNT(bytesSerialized, out ? length * qint64(sizeof(QChar)) : 0);
+    return length;
 }
 
-Expression *ExprImply::getCopy() const
+/* The canonical text (not bracketized) is cached by the node: */
+QString Expression::getStr(bool bracketized) const
 {
-    return new ExprImply(e1->getCopy(), e2->getCopy());
+    if (!bracketized) {
+        if (kind == Variable)
+            return static_cast<const ExprVar *>(this)->getName();
+        const ExprText *cached = strCache.loadAcquire();
+        if (cached)
+            return cached->text;
+    }
+    QString result(serialize(this, bracketized, NULL), Qt::Uninitialized);
+    serialize(this, bracketized, result.data());
+    if (!bracketized && (result.length() <= STR_CACHE_MAX_LENGTH)) {
+        ExprText *entry = new ExprText;
+        entry->text = result;
+        entry->hash = qHash(result);
+        if (!strCache.testAndSetOrdered(NULL, entry))
+            delete entry;
+    }
+    return result;
 }
 
-void ExprImply::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming)
+int Expression::getStrLength(bool bracketized) const
 {
-    e1->replaceVariableNames(renaming);
-    e2->replaceVariableNames(renaming);
+    return serialize(this, bracketized, NULL);
 }
 
-int ExprImply::getLevel() const
+/* Appends the text to out, which grows once: */
+void Expression::writeStr(QString &out, bool bracketized) const
 {
-    return 3;
+    int length = serialize(this, bracketized, NULL);
+    int start = out.length();
+    out.resize(start + length);
+    serialize(this, bracketized, out.data() + start);
 }
 
-ExprEquiv::ExprEquiv(Expression *e1, Expression *e2) : e1(e1), e2(e2) {}
+/* Hash of the canonical text, equal to qHash(getStr()): */
+uint Expression::getStrHash() const
+{
+    const ExprText *cached = strCache.loadAcquire();
+    if (cached)
+        return cached->hash;
+    QString text = getStr();
+    cached = strCache.loadAcquire();
+    return cached ? cached->hash : qHash(text);
+}
 
-QString ExprEquiv::getStr(bool bracketized) const
+VarSet Expression::getVariableSet() const
 {
-    return e1->getLevelCompliantStr(2, bracketized) + QStringLiteral("=") + e2->getLevelCompliantStr(2, bracketized);
+    if (variablesStored)
+        return variables;
+    /* Only nodes over many variables get here; their largest stored subformulas are merged: */
+    VarSet result;
+    QSet<const Expression *> visited;
+    QVector<const Expression *> stack;
+    stack.append(this);
+    while (!stack.isEmpty()) {
+        const Expression *e = stack.takeLast();
+        if (e->variablesStored) {
+            result |= e->variables;
+            continue;
+        }
+        if (visited.contains(e))
+            continue;
+        visited.insert(e);
+        for (int i = e->getOperandCount(); i-- > 0;)
+            stack.append(e->getOperand(i));
+    }
+    return result;
 }
 
-QSet<QString> ExprEquiv::getVariables() const
+bool Expression::hasVariableIn(const VarSet &set) const
 {
-    return e1->getVariables() | e2->getVariables();
+    return variablesStored ? variables.intersects(set) : getVariableSet().intersects(set);
 }
 
-Expression *ExprEquiv::getCopy() const
+QSet<QString> Expression::getVariables() const
 {
-    return new ExprEquiv(e1->getCopy(), e2->getCopy());
+    return getVariableSet().getNames();
 }
 
-void ExprEquiv::replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming)
+const Expression *Expression::replaceVariableNames(const QMap<QString, const Expression *> &renaming) const
 {
-    e1->replaceVariableNames(renaming);
-    e2->replaceVariableNames(renaming);
+    return Substitution(renaming).apply(this);
 }
 
-int ExprEquiv::getLevel() const
+/* Marks an open parenthesis on the operator stack of the parser: */
+#define PARSE_PAREN (-1)
+
+/* Connective denoted by a character, in either notation, or -1: */
+static inline int connectiveKind(ushort c)
 {
-    return 3;
+    switch (c) {
+    case '~':
+    case 0x00AC: /* ¬ */
+        return Expression::NOT;
+    case '|':
+    case 0x2228: /* ∨ */
+        return Expression::OR;
+    case '&':
+    case 0x2227: /* ∧ */
+        return Expression::AND;
+    case '>':
+    case 0x2192: /* → */
+    case 0x21D2: /* ⇒ */
+    case 0x27F6: /* ⟶ */
+    case 0x27F9: /* ⟹ */
+        return Expression::Imply;
+    case '=':
+    case 0x2194: /* ↔ */
+    case 0x21D4: /* ⇔ */
+    case 0x27F7: /* ⟷ */
+    case 0x27FA: /* ⟺ */
+        return Expression::Equiv;
+    default:
+        return -1;
+    }
 }
 
-Rule::Rule(QList<QSharedPointer<Expression> > premises, QList<QSharedPointer<Expression> > conclusions) : premises(premises), conclusions(conclusions) {}
+struct ParseOperator
+{
+    int kind, position;
+};
 
-QString Rule::getStr(bool bracketized) const
+/* Replaces the two topmost operands with their combination by the topmost operator: */
+static inline void reduceBinary(QVector<const Expression *> &operands, QVector<ParseOperator> &operators)
 {
-    QString result;
-    if (conclusions.isEmpty())
-        return QString();
-    if (premises.isEmpty()) {
-        result = ": ";
-    } else {
-        result = premises.first()->getStr(bracketized);
-        for (int i = premises.size(); --i > 0;)
-            result += QStringLiteral(", ") + premises[i]->getStr(bracketized);
-        result += " : ";
-    }
-    result += conclusions.first()->getStr(bracketized);
-    for (int i = conclusions.size(); --i > 0;)
-        result += QStringLiteral(", ") + conclusions[i]->getStr(bracketized);
-    return result;
+    const Expression *e2 = operands.takeLast();
+    operands.last() = ExprFactory::make(Expression::Kind(operators.takeLast().kind), operands.last(), e2);
 }
 
-QList<QSharedPointer<Expression> > Rule::getPremises() const
+static inline void reduceNegations(QVector<const Expression *> &operands, QVector<ParseOperator> &operators)
 {
-    return premises;
+    while (!operators.isEmpty() && (operators.last().kind == Expression::NOT)) {
+        operators.removeLast();
+        operands.last() = ExprFactory::makeNOT(operands.last());
+    }
 }
 
-QList<QSharedPointer<Expression> > Rule::getConclusions() const
+static const Expression *parseError(QString *error, int *errorPosition, const QString &message, int position)
 {
-    return conclusions;
+    if (error)
+        *error = QObject::tr("%1 at character %2.").arg(message).arg(position + 1);
+    if (errorPosition)
+        *errorPosition = position;
+    return NULL;
 }
 
-QSet<QString> Rule::getInputVariables() const
+/*
+ * Operator-precedence parser with explicit stacks, so that the nesting depth is
+ * only limited by memory. Operators are pushed until an operand is complete;
+ * negations are applied as soon as their operand is, and a binary operator first
+ * reduces the pending ones that bind tighter. Blanks between tokens are ignored.
+ */
+static const Expression *parseFormula(const QString &str, int i, int end, QString *error, int *errorPosition)
 {
-    QSet<QString> result;
-    foreach (const QSharedPointer<Expression> &e, premises)
-        result |= e->getVariables();
-    return result;
+    const QChar *data = str.constData();
+    QVector<const Expression *> operands;
+    QVector<ParseOperator> operators;
+    bool expectOperand = true;
+    for (;;) {
+        while ((i < end) && data[i].isSpace())
+            ++i;
+        if (expectOperand) {
+            if (i >= end)
+                return parseError(error, errorPosition, QObject::tr("Missing operand"), i);
+            ushort c = data[i].unicode();
+            if ((c == '(') || (connectiveKind(c) == Expression::NOT)) {
+                ParseOperator op;
+                op.kind = (c == '(') ? PARSE_PAREN : int(Expression::NOT);
+                op.position = i++;
+                operators.append(op);
+                continue;
+            }
+            int start = i;
+            while ((i < end) && data[i].isLetter())
+                ++i;
+            if (i == start)
+                return parseError(error, errorPosition, QObject::tr("Expected a variable, '(' or a negation"), i);
+            operands.append(ExprFactory::makeVar(QString(data + start, i - start)));
+            reduceNegations(operands, operators);
+            expectOperand = false;
+            continue;
+        }
+        if (i >= end)
+            break;
+        ushort c = data[i].unicode();
+        if (c == ')') {
+            while (!operators.isEmpty() && (operators.last().kind != PARSE_PAREN))
+                reduceBinary(operands, operators);
+            if (operators.isEmpty())
+                return parseError(error, errorPosition, QObject::tr("Unmatched ')'"), i);
+            operators.removeLast();
+            reduceNegations(operands, operators);
+            ++i;
+            continue;
+        }
+        int kind = connectiveKind(c);
+        if (kind <= Expression::NOT)
+            return parseError(error, errorPosition, QObject::tr("Expected a binary connective or ')'"), i);
+        while (!operators.isEmpty() && (operators.last().kind != PARSE_PAREN)
+               && (kindLevel[operators.last().kind] <= kindLevel[kind])) {
+            if (kindLevel[operators.last().kind] == kindLevel[kind])
+                return parseError(error, errorPosition, QObject::tr("Ambiguous connective, parentheses needed"), i);
+            reduceBinary(operands, operators);
+        }
+        ParseOperator op;
+        op.kind = kind;
+        op.position = i++;
+        operators.append(op);
+        expectOperand = true;
+    }
+    while (!operators.isEmpty()) {
+        if (operators.last().kind == PARSE_PAREN)
+            return parseError(error, errorPosition, QObject::tr("Unmatched '('"), operators.last().position);
+        reduceBinary(operands, operators);
+    }
+    return operands.first();
 }
 
-QSet<QString> Rule::getOutputVariables() const
+const Expression *Expression::fromStr(const QString &str, QString *error, int *errorPosition)
 {
-    QSet<QString> result;
-    foreach (const QSharedPointer<Expression> &e, conclusions)
-        result |= e->getVariables();
-    return result;
+    return parseFormula(str, 0, str.length(), error, errorPosition);
 }
 
-Rule *Rule::adapt(QMap<QString, QSharedPointer<Expression> > renaming) const
+ExprVar::ExprVar(const QString &variableName, int id) : Expression(Variable, qHash(variableName)), varName(variableName), varId(id)
 {
-    QList< QSharedPointer<Expression> > o_premises, o_conclusions;
-    o_premises.reserve(premises.size());
-    foreach (const QSharedPointer<Expression> &prem, premises)
-        o_premises.append(prem->replaceVariableNames(renaming));
-    o_conclusions.reserve(conclusions.size());
-    foreach (const QSharedPointer<Expression> &cl, conclusions)
-        o_conclusions.append(cl->replaceVariableNames(renaming));
-    return new Rule(o_premises, o_conclusions);
+    variables.insert(id);
 }
 
-Rule *Rule::fromStr(const QString &str)
+const QString &ExprVar::getName() const
 {
-    QList< QSharedPointer<Expression> > premises, conclusions;
-    int colon = str.indexOf(':');
-    if (colon < 0)
-        return NULL;
-    QStringList prems = str.left(colon).trimmed().split(',', QString::SkipEmptyParts);
-    foreach (const QString &prem, prems) {
-        Expression *ptr = Expression::fromStr(prem.trimmed());
-        if (!ptr)
-            return NULL;
-        premises.append(QSharedPointer<Expression>(ptr));
-    }
-    QStringList cls = str.mid(colon + 1).trimmed().split(',', QString::SkipEmptyParts);
-    if (cls.isEmpty())
-        return NULL;
-    foreach (const QString &cl, cls) {
-        Expression *ptr = Expression::fromStr(cl.trimmed());
-        if (!ptr)
-            return NULL;
-        conclusions.append(QSharedPointer<Expression>(ptr));
-    }
-    return new Rule(premises, conclusions);
+    return varName;
 }
 
-Proof::Proof(QSharedPointer<Rule> rule) : rule(rule), ok(true), finished(false)
-{
-    basicRulesLock.lock();
-    if (basicRules.isEmpty()) {
-        basicRules[":ElimAnd"] = QSharedPointer<Rule>(Rule::fromStr("X&Y : X, Y"));
-        basicRules[":IntroAnd"] = QSharedPointer<Rule>(Rule::fromStr("X, Y : X&Y"));
-        basicRules[":ElimOr1"] = QSharedPointer<Rule>(Rule::fromStr("X|Y, ~X : Y"));
-        basicRules[":ElimOr2"] = QSharedPointer<Rule>(Rule::fromStr("X|Y, ~Y : X"));
-        basicRules[":IntroOr"] = QSharedPointer<Rule>(Rule::fromStr("X : X|Y, Y|X"));
-        basicRules[":ElimArrow"] = QSharedPointer<Rule>(Rule::fromStr("X, X>Y : Y"));
-        // Note: ":Assume", ":IntroArrow" and ":RAA" are also handled separately for correctness.
-        basicRules[":Assume"] = QSharedPointer<Rule>(Rule::fromStr(": X"));
-        basicRules[":IntroArrow"] = QSharedPointer<Rule>(Rule::fromStr("Y : X>Y"));
-        basicRules[":RAA"] = QSharedPointer<Rule>(Rule::fromStr("Y, ~Y : X"));
-        // Note: ":Assume", ":IntroArrow" and ":RAA" are also handled separately for correctness.
-        basicRules[":ElimEquiv"] = QSharedPointer<Rule>(Rule::fromStr("X=Y : X>Y, Y>X"));
-        basicRules[":IntroEquiv"] = QSharedPointer<Rule>(Rule::fromStr("X>Y, Y>X : X=Y"));
-        basicRules[":Conclusion"] = QSharedPointer<Rule>(Rule::fromStr("X : X"));
-    }
-    basicRulesLock.unlock();
-    if (rule->getConclusions().isEmpty()) {
-        ok = false;
-        return;
-    }
-    QList< QSharedPointer<Expression> > premises = rule->getPremises();
-    steps.reserve(2 * premises.size());
-    for (int i = 0; i < premises.size(); ++i) {
-        Step step;
-        step.indentation = 0;
-        step.output = premises[i]->getStr();
-        step.rule = "-";
-        step.clIndex = 0;
-        steps.append(step);
-    }
+int ExprVar::getId() const
+{
+    return varId;
 }
 
-Proof::Proof(QString filename) : ok(false)
+ExprNOT::ExprNOT(const Expression *e) : Expression(NOT, combineHash(NOT, e), e), e(e) {}
+
+const Expression *ExprNOT::getChild(int index) const
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        lastError = "Could not open file for reading";
+    return index ? NULL : e;
+}
+
+/* Called with the factory locked, which serializes the growth of the blocks: */
+ExprNary::ExprNary(Kind kind, const Expression *e1, const Expression *e2)
+    : Expression(kind, combineHash(kind, e1, e2), e1, e2), head(e1), tail(e2), block(NULL), count(2)
+{
+    if (e2->getKind() != kind)
         return;
+    const ExprNary *inner = static_cast<const ExprNary *>(e2);
+    count = inner->count + 1;
+    if (inner->block && (inner->block->used == inner->count) && (inner->block->used < inner->block->capacity)) {
+        block = inner->block;
+    } else {
+        /* The inner chain is shared with a longer one already, or full; its operands are copied: */
+        block = allocateOperandBlock(qMax(OPERAND_BLOCK_MIN_CAPACITY, 2 * count));
+        for (int i = inner->count; i-- > 0;)
+            block->items[block->used++] = inner->getOperand(i);
     }
-    QTextStream in(&file);
-    rule = QSharedPointer<Rule>(Rule::fromStr(in.readLine()));
-    QString s;
-    int n, i;
-    while (in >> s, s != "IDX") {
-        Step step;
-        step.output = s;
-        in >> s;
-        s.replace("%20", " ");
-        step.rule = s;
-        in >> n;
-        step.usedInputs.reserve(n);
-        for (int j = n; j--;) {
-            in >> i;
-            step.usedInputs.append(i);
-        }
-        in >> step.clIndex >> step.indentation;
-        while (in >> s, s != "END_STEP") {
-            if (in.atEnd()) {
-                lastError = "Unexpected end of file";
-                file.close();
-                return;
-            }
-            if ((i = s.indexOf(':')) < 0) {
-                lastError = "Wrong renaming rule";
-                file.close();
-                return;
-            }
-            step.renaming[s.left(i)] = s.mid(i + 1);
+    block->items[block->used++] = e1;
+}
+
+const Expression *ExprNary::getChild(int index) const
+{
+    return index ? tail : head;
+}
+
+ExprOR::ExprOR(const Expression *e1, const Expression *e2) : ExprNary(OR, e1, e2) {}
+
+ExprAND::ExprAND(const Expression *e1, const Expression *e2) : ExprNary(AND, e1, e2) {}
+
+ExprImply::ExprImply(const Expression *e1, const Expression *e2) : Expression(Imply, combineHash(Imply, e1, e2), e1, e2), e1(e1), e2(e2) {}
+
+const Expression *ExprImply::getChild(int index) const
+{
+    return index ? e2 : e1;
+}
+
+ExprEquiv::ExprEquiv(const Expression *e1, const Expression *e2) : Expression(Equiv, combineHash(Equiv, e1, e2), e1, e2), e1(e1), e2(e2) {}
+
+const Expression *ExprEquiv::getChild(int index) const
+{
+    return index ? e2 : e1;
+}
+
+const Expression *ExprFactory::makeVar(const QString &variableName)
+{
+    QString name = variableName;
+    for (int i = name.length(); i-- > 0;) {
+        if (!name[i].isLetter()) {
+            name = "?";
+            break;
         }
-        steps.append(step);
     }
-    in >> n;
-    stepIndexes.reserve(n);
-    for (int j = n; j--;) {
-        in >> i;
-        stepIndexes.append(i);
+    QMutexLocker locker(&exprTableLock);
+    const Expression *&result = varTable[name];
+    if (!result) {
+        ExprVar *var = new (exprArena.allocate(sizeof(ExprVar))) ExprVar(name, varById.size());
+        varById.append(var);
+        result = var;
+        PROFILE_COUNT(nodesAllocated, 1);
     }
-    file.close();
-    if (ok = verifyCorrect())
-        finished = verifyFinished();
+    return result;
 }
 
-bool Proof::saveToFile(QString filename) const
+const Expression *ExprFactory::makeNOT(const Expression *e)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly)) {
-        lastError = "Could not open file for writing";
-        return false;
-    }
-    file.write((rule->getStr() + "\n").toLocal8Bit());
-    for (int i = 0; i < steps.size(); ++i) {
-        const Step &currentStep = steps[i];
-        file.write(currentStep.output.toLocal8Bit());
-        file.write(" ");
-        QString ruleModif = currentStep.rule;
-        ruleModif.replace(" ", "%20");
-        file.write(ruleModif.toLocal8Bit());
-        file.write((QStringLiteral(" ") + QString::number(currentStep.usedInputs.size()) + " ").toLocal8Bit());
-        for (int j = 0; j < currentStep.usedInputs.size(); ++j)
-            file.write((QString::number(currentStep.usedInputs[j]) + " ").toLocal8Bit());
-        file.write((QString::number(currentStep.clIndex) + " " + QString::number(currentStep.indentation) + " ").toLocal8Bit());
-        QMap<QString,QString>::const_iterator it = currentStep.renaming.constBegin();
-        while (it != currentStep.renaming.constEnd()) {
-            file.write((it.key() + ":" + it.value() + " ").toLocal8Bit());
-            ++it;
-        }
-        file.write("END_STEP\n");
-    }
-    file.write((QStringLiteral("IDX ") + QString::number(stepIndexes.size())).toLocal8Bit());
-    for (int i = 0; i < stepIndexes.size(); ++i)
-        file.write((QStringLiteral(" ") + QString::number(stepIndexes[i])).toLocal8Bit());
-    file.write("\n");
-    file.close();
+    return make(Expression::NOT, e);
 }
 
-bool Proof::isCorrect() const
+const Expression *ExprFactory::makeOR(const Expression *e1, const Expression *e2)
 {
-    return ok;
+    return make(Expression::OR, e1, e2);
 }
 
-bool Proof::isFinished() const
+const Expression *ExprFactory::makeAND(const Expression *e1, const Expression *e2)
 {
-    return finished;
+    return make(Expression::AND, e1, e2);
 }
 
-QSharedPointer<Rule> Proof::getRule() const
+const Expression *ExprFactory::makeImply(const Expression *e1, const Expression *e2)
 {
-    return rule;
+    return make(Expression::Imply, e1, e2);
 }
 
-bool Proof::verifyCorrect() const
+const Expression *ExprFactory::makeEquiv(const Expression *e1, const Expression *e2)
 {
-    QList< QSharedPointer<Expression> > premises = rule->getPremises();
-    QList<bool> accessible;
-    accessible.reserve(steps.size());
-    int indent = 0;
-    for (int i = premises.size(); i-- > 0;) {
-        const Step &currentStep = steps[i];
-        if (currentStep.indentation != indent)
-            return false;
-        if (premises[i]->getStr() != currentStep.output)
-            return false;
-        accessible.append(true);
+    return make(Expression::Equiv, e1, e2);
+}
+
+const Expression *ExprFactory::make(Expression::Kind kind, const Expression *e1, const Expression *e2)
+{
+    ExprKey key;
+    key.kind = kind;
+    key.e1 = e1;
+    key.e2 = (kind == Expression::NOT) ? NULL : e2;
+    QMutexLocker locker(&exprTableLock);
+    const Expression *&result = exprTable[key];
+    if (result)
+        return result;
+    switch (kind) {
+    case Expression::NOT:
+        result = new (exprArena.allocate(sizeof(ExprNOT))) ExprNOT(e1);
+        break;
+    case Expression::OR:
+        result = new (exprArena.allocate(sizeof(ExprOR))) ExprOR(e1, e2);
+        break;
+    case Expression::AND:
+        result = new (exprArena.allocate(sizeof(ExprAND))) ExprAND(e1, e2);
+        break;
+    case Expression::Imply:
+        result = new (exprArena.allocate(sizeof(ExprImply))) ExprImply(e1, e2);
+        break;
+    case Expression::Equiv:
+        result = new (exprArena.allocate(sizeof(ExprEquiv))) ExprEquiv(e1, e2);
+        break;
+    default:
+        exprTable.remove(key);
+        return NULL;
     }
-    for (int i = premises.size(); i < steps.size(); ++i) {
-        const Step &currentStep = steps[i];
-        if (currentStep.rule == ":Assume") {
-            ++indent;
-        } else if ((currentStep.rule == ":IntroArrow") || (currentStep.rule == ":RAA")) {
-            --indent;
-        }
-        if (currentStep.indentation != indent)
-            return false;
-        QSharedPointer<Rule> subRule;
-        if (currentStep.rule[0] == ':') {
-            subRule = basicRules.value(currentStep.rule);
-            if (subRule.isNull()) {
-                lastError = QObject::tr("Unrecognized rule \"%1\".").arg(currentStep.rule);
-                return false;
-            }
-        } else {
-            Proof *proof = new Proof(currentStep.rule);
-            if (!proof->isCorrect()) {
-                delete proof;
-                lastError = QObject::tr("Lemma \"%1\" is not found or not correct.").arg(currentStep.rule);
-                return false;
-            }
-            if (!proof->isFinished()) {
-                delete proof;
-                lastError = QObject::tr("Lemma \"%1\" is not finished.").arg(currentStep.rule);
-                return false;
-            }
-            subRule = proof->getRule();
-            delete proof;
-        }
-        subRule = QSharedPointer<Rule>(subRule->adapt(currentStep.renaming));
-        premises = subRule->getPremises();
-        if (premises.size() != currentStep.usedInputs.size())
-            return false;
-        for (int j = premises.size(); j-- > 0;) {
-            if ((currentStep.usedInputs[j] < 0) || (currentStep.usedInputs[j] >= i))
-                return false;
-            if (steps[currentStep.usedInputs[j]].output != premises[j]->getStr())
-                return false;
-            if (!accessible[currentStep.usedInputs[j]])
-                return false;
-        }
-        if ((currentStep.clIndex < 0) || (currentStep.clIndex > subRule->getConclusions().size()))
-            return false;
-        if (output != subRule->getConclusions().at(currentStep.clIndex)->getStr())
-            return false;
-        if ((currentStep.rule == ":IntroArrow") || (currentStep.rule == ":RAA")) {
-            int j = i - 1;
-            while ((j >= 0) && (steps[j].indentation > indent))
-                accessible[j--] = false;
-            if (steps[++j].renaming["X"] != currentStep.renaming["X"])
-                return false;
-        }
+    PROFILE_COUNT(nodesAllocated, 1);
+    return result;
+}
+
+const ExprVar *ExprFactory::getVar(int id)
+{
+    QVector<const ExprVar *> &known = knownVarIds.localData();
+    if ((id >= 0) && (id < known.size()))
+        return known[id];
+    QMutexLocker locker(&exprTableLock);
+    if ((id < 0) || (id >= varById.size()))
+        return NULL;
+    for (int i = known.size(); i < varById.size(); ++i)
+        known.append(varById[i]);
+    return known[id];
+}
+
+int ExprFactory::findVar(const QString &variableName)
+{
+    QHash<QString, const ExprVar *> &known = knownVarNames.localData();
+    const ExprVar *var = known.value(variableName, NULL);
+    if (!var) {
+        QMutexLocker locker(&exprTableLock);
+        var = static_cast<const ExprVar *>(varTable.value(variableName, NULL));
+        if (!var)
+            return -1;
+        known.insert(variableName, var);
     }
-    return true;
+    return var->getId();
 }
 
-bool Proof::verifyFinished() const
+int ExprFactory::getVarCount()
 {
-    QList< QSharedPointer<Expression> > conclusions = rule->getConclusions();
-    if (steps.last().indentation)
-        return false;
+    QMutexLocker locker(&exprTableLock);
+    return varById.size();
+}
+
+ExprFactory::Stats ExprFactory::getStats()
+{
+    QMutexLocker locker(&exprTableLock);
+    Stats stats;
+    stats.nodeCount = varTable.size() + exprTable.size();
+    stats.nodeBytes = exprArena.used;
+    stats.arenaBytes = exprArena.reserved;
+    return stats;
+}
+
+Substitution::Substitution(const QMap<QString, const Expression *> &renaming)
+{
+    QMap<QString, const Expression *>::const_iterator it;
+    for (it = renaming.constBegin(); it != renaming.constEnd(); ++it) {
+        /* Names no expression uses cannot occur, and identities change nothing: */
+        int id = ExprFactory::findVar(it.key());
+        if ((id < 0) || !it.value() || (it.value() == ExprFactory::getVar(id)))
+            continue;
+        if (id >= images.size())
+            images.resize(id + 1);
+        images[id] = it.value();
+        domain.insert(id);
+    }
+}
+
+/* Postorder walk: a node is expanded first, then rebuilt from the results of its operands: */
+const Expression *Substitution::apply(const Expression *e)
+{
+    QVector<QPair<const Expression *, bool> > stack;
+    QVector<const Expression *> results;
+    stack.append(qMakePair(e, false));
+    while (!stack.isEmpty()) {
+        QPair<const Expression *, bool> &top = stack.last();
+        const Expression *node = top.first;
+        if (!top.second) {
+            const Expression *known = NULL;
+            if (!node->hasVariableIn(domain))
+                known = node;
+            else if (node->getKind() == Expression::Variable)
+                known = images[static_cast<const ExprVar *>(node)->getId()];
+            else
+                known = memo.value(node, NULL);
+            if (known) {
+                results.append(known);
+                stack.removeLast();
+                continue;
+            }
+            top.second = true;
+            for (int i = node->getOperandCount(); i-- > 0;)
+                stack.append(qMakePair(node->getOperand(i), false));
+            continue;
+        }
+        stack.removeLast();
+        int n = node->getOperandCount();
+        const Expression *const *operands = results.constData() + results.size() - n;
+        const Expression *result;
+        if (node->getKind() == Expression::NOT) {
+            result = ExprFactory::makeNOT(operands[0]);
+        } else {
+            /* A chain is rebuilt from its innermost node, which lets its operand block grow in place: */
+            result = operands[n - 1];
+            for (int i = n - 1; i-- > 0;)
+                result = ExprFactory::make(node->getKind(), operands[i], result);
+        }
+        memo.insert(node, result);
+        results.resize(results.size() - n);
+        results.append(result);
+    }
+    return results.first();
+}
+
+/* Only the pattern is walked: the images of its variables are compared by pointer with the formula: */
+bool Substitution::maps(const Expression *pattern, const Expression *formula) const
+{
+    QVector<QPair<const Expression *, const Expression *> > stack;
+    stack.append(qMakePair(pattern, formula));
+    while (!stack.isEmpty()) {
+        QPair<const Expression *, const Expression *> top = stack.takeLast();
+        if (!top.first->hasVariableIn(domain)) {
+            if (top.first != top.second)
+                return false;
+            continue;
+        }
+        if (top.first->getKind() == Expression::Variable) {
+            if (images[static_cast<const ExprVar *>(top.first)->getId()] != top.second)
+                return false;
+            continue;
+        }
+        if (top.first->getKind() != top.second->getKind())
+            return false;
+        for (int i = top.first->getChildCount(); i-- > 0;)
+            stack.append(qMakePair(top.first->getChild(i), top.second->getChild(i)));
+    }
+    return true;
+}
+
+Rule::Rule(QList<const Expression *> premises, QList<const Expression *> conclusions) : premises(premises), conclusions(conclusions)
+{
+    foreach (const Expression *e, premises)
+        inputVariables |= e->getVariableSet();
+    foreach (const Expression *e, conclusions)
+        outputVariables |= e->getVariableSet();
+}
+
+QString Rule::getStr(bool bracketized) const
+{
+    if (conclusions.isEmpty())
+        return QString();
+    /* Separators take two characters, and the colon one more after premises: */
+    int length = 2 * (premises.size() + conclusions.size() - 1) + (premises.isEmpty() ? 2 : 1);
+    foreach (const Expression *e, premises)
+        length += e->getStrLength(bracketized);
+    foreach (const Expression *e, conclusions)
+        length += e->getStrLength(bracketized);
+    QString result;
+    result.reserve(length);
+    for (int i = 0; i < premises.size(); ++i) {
+        if (i)
+            result += QStringLiteral(", ");
+        premises[i]->writeStr(result, bracketized);
+    }
+    result += premises.isEmpty() ? QStringLiteral(": ") : QStringLiteral(" : ");
+    for (int i = 0; i < conclusions.size(); ++i) {
+        if (i)
+            result += QStringLiteral(", ");
+        conclusions[i]->writeStr(result, bracketized);
+    }
+    return result;
+}
+
+QList<const Expression *> Rule::getPremises() const
+{
+    return premises;
+}
+
+QList<const Expression *> Rule::getConclusions() const
+{
+    return conclusions;
+}
+
+QSet<QString> Rule::getInputVariables() const
+{
+    return inputVariables.getNames();
+}
+
+QSet<QString> Rule::getOutputVariables() const
+{
+    return outputVariables.getNames();
+}
+
+const VarSet &Rule::getInputVariableSet() const
+{
+    return inputVariables;
+}
+
+const VarSet &Rule::getOutputVariableSet() const
+{
+    return outputVariables;
+}
+
+Rule *Rule::adapt(const QMap<QString, const Expression *> &renaming) const
+{
+    PROFILE_COUNT(adaptCalls, 1);
+    Substitution substitution(renaming);
+    QList<const Expression *> o_premises, o_conclusions;
+    o_premises.reserve(premises.size());
+    foreach (const Expression *prem, premises)
+        o_premises.append(substitution.apply(prem));
+    o_conclusions.reserve(conclusions.size());
+    foreach (const Expression *cl, conclusions)
+        o_conclusions.append(substitution.apply(cl));
+    return new Rule(o_premises, o_conclusions);
+}
+
+/* Parses the comma-separated formulas between from and to, skipping the empty ones: */
+static bool parseFormulas(const QString &str, int from, int to, QList<const Expression *> &formulas, QString *error)
+{
+    while (from < to) {
+        int comma = str.indexOf(',', from);
+        if ((comma < 0) || (comma > to))
+            comma = to;
+        int start = from;
+        while ((start < comma) && str[start].isSpace())
+            ++start;
+        int end = comma;
+        while ((end > start) && str[end - 1].isSpace())
+            --end;
+        if (end > start) {
+            const Expression *formula = parseFormula(str, start, end, error, NULL);
+            if (!formula)
+                return false;
+            formulas.append(formula);
+        }
+        from = comma + 1;
+    }
+    return true;
+}
+
+/* Premises and conclusions are separated by ':' or '⊦': */
+Rule *Rule::fromStr(const QString &str, QString *error)
+{
+    QList<const Expression *> premises, conclusions;
+    int colon = str.indexOf(':');
+    if (colon < 0)
+        colon = str.indexOf(QChar(0x22A6));
+    if (colon < 0) {
+        if (error)
+            *error = QObject::tr("Missing ':' between the premises and the conclusions.");
+        return NULL;
+    }
+    if (!parseFormulas(str, 0, colon, premises, error) || !parseFormulas(str, colon + 1, str.length(), conclusions, error))
+        return NULL;
+    if (conclusions.isEmpty()) {
+        if (error)
+            *error = QObject::tr("A rule needs a conclusion.");
+        return NULL;
+    }
+    return new Rule(premises, conclusions);
+}
+
+ProofProfile::ProofProfile()
+    : loadNsecs(0), scopeNsecs(0), stepsNsecs(0),
+      lemmaLoads(0), adaptCalls(0), matchCalls(0), nodesAllocated(0), bytesSerialized(0) {}
+
+void ProofProfile::addStep(int index, const QString &rule, qint64 nsecs)
+{
+    if (index >= stepNsecs.size())
+        stepNsecs.resize(index + 1);
+    stepNsecs[index] = nsecs;
+    stepsNsecs += nsecs;
+    Timing &timing = ruleTimes[(rule.startsWith(':') || (rule == "-")) ? rule : QString(PROFILE_LEMMA_RULE)];
+    ++timing.count;
+    timing.nsecs += nsecs;
+}
+
+void ProofProfile::addLemma(const QString &lemma, qint64 nsecs)
+{
+    ++lemmaLoads;
+    lemmaNsecs[lemma] += nsecs;
+}
+
+bool ProofProfile::isEnabled()
+{
+#if defined(AUBS_PROFILE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+ScopeTracker::ScopeTracker() {}
+
+void ScopeTracker::clear()
+{
+    depth.clear();
+    scope.clear();
+    bound.clear();
+    open.clear();
+    assumptions.clear();
+}
+
+void ScopeTracker::reserve(int stepCount)
+{
+    depth.reserve(stepCount);
+    scope.reserve(stepCount);
+    bound.reserve(stepCount);
+}
+
+int ScopeTracker::append(const Step &step)
+{
+    int index = depth.size();
+    int stepDepth = depth.isEmpty() ? 0 : depth.last();
+    int stepBound = -1;
+    switch (step.basicRule) {
+    case AssumeRule:
+        ++stepDepth;
+        stepBound = INT_MAX;
+        open.append(index);
+        assumptions.insert(index, step.renaming.value("X", NULL));
+        break;
+    case IntroArrowRule:
+    case RAARule:
+        --stepDepth;
+        if (!open.isEmpty()) {
+            bound[open.last()] = index;
+            stepBound = open.takeLast();
+        }
+        break;
+    default:
+        break;
+    }
+    depth.append(stepDepth);
+    scope.append(open.isEmpty() ? -1 : open.last());
+    bound.append(stepBound);
+    return index;
+}
+
+int ScopeTracker::getStepCount() const
+{
+    return depth.size();
+}
+
+int ScopeTracker::getDepth(int index) const
+{
+    return depth[index];
+}
+
+int ScopeTracker::getScope(int index) const
+{
+    return scope[index];
+}
+
+int ScopeTracker::getBound(int index) const
+{
+    return bound[index];
+}
+
+const Expression *ScopeTracker::getAssumption(int index) const
+{
+    return assumptions.value(index, NULL);
+}
+
+/* The scopes enclosing that of step j close after it, so that it is enough to look at the innermost: */
+bool ScopeTracker::isVisible(int j, int i) const
+{
+    return (scope[j] < 0) || (bound[scope[j]] >= i);
+}
+
+bool ScopeTracker::isScopeRule(BasicRule rule)
+{
+    return (rule == AssumeRule) || (rule == IntroArrowRule) || (rule == RAARule);
+}
+
+static QVector<QSharedPointer<Rule> > parseBasicRules()
+{
+    QVector<QSharedPointer<Rule> > trees(BasicRuleCount);
+    for (int i = 0; i < BasicRuleCount; ++i)
+        trees[i] = QSharedPointer<Rule>(Rule::fromStr(basicRuleInfo[i].rule));
+    return trees;
+}
+
+/* Parsed once, on first use; the later calls only check that the table is built: */
+static const QVector<QSharedPointer<Rule> > &getBasicRuleTrees()
+{
+    static const QVector<QSharedPointer<Rule> > trees = parseBasicRules();
+    return trees;
+}
+
+QMap<QString, QSharedPointer<Rule> > Proof::getBasicRules()
+{
+    QMap<QString, QSharedPointer<Rule> > result;
+    for (int i = 0; i < BasicRuleCount; ++i)
+        result.insert(basicRuleInfo[i].name, getBasicRuleTrees()[i]);
+    return result;
+}
+
+BasicRule Proof::getBasicRule(const QString &name)
+{
+    if (!name.startsWith(':'))
+        return NoBasicRule;
+    for (int i = 0; i < BasicRuleCount; ++i) {
+        if (name == QLatin1String(basicRuleInfo[i].name))
+            return BasicRule(i);
+    }
+    return NoBasicRule;
+}
+
+Proof::Proof(QSharedPointer<Rule> rule) : rule(rule), ok(true), finished(false), verified(false), invalidCount(0)
+{
+    if (rule->getConclusions().isEmpty()) {
+        ok = false;
+        return;
+    }
+    QList<const Expression *> premises = rule->getPremises();
+    steps.reserve(2 * premises.size());
+    for (int i = 0; i < premises.size(); ++i) {
+        Step step;
+        step.indentation = 0;
+        step.output = premises[i];
+        step.rule = "-";
+        step.clIndex = 0;
+        step.basicRule = NoBasicRule;
+        steps.append(step);
+    }
+    ok = verifyCorrect();
+}
+
+Proof::Proof(QSharedPointer<Rule> rule, const QList<Step> &steps, const QList<int> &stepIndexes, bool verify)
+    : rule(rule), steps(steps), stepIndexes(stepIndexes), ok(false), finished(false), verified(false), invalidCount(0)
+{
+    /* Only the steps built without their basic rule are written, which copies the list: */
+    for (int i = 0; i < this->steps.size(); ++i) {
+        BasicRule basicRule = getBasicRule(this->steps.at(i).rule);
+        if (this->steps.at(i).basicRule != basicRule)
+            this->steps[i].basicRule = basicRule;
+    }
+    if (!verify)
+        return;
+    if ((ok = verifyCorrect()))
+        finished = verifyFinished();
+}
+
+Proof::Proof(QString filename, bool verify) : filename(filename), ok(false), finished(false), verified(false), invalidCount(0)
+{
+    PROFILE_SCOPE();
+    PROFILE(QElapsedTimer loadTimer; loadTimer.start();)
+    bool loaded = BinaryProof::isBinaryFile(filename) ? loadBinary() : loadText();
+    PROFILE(profile.loadNsecs += loadTimer.nsecsElapsed();)
+    if (!loaded)
+        return;
+    if (!verify)
+        return;
+    if ((ok = verifyCorrect()))
+        finished = verifyFinished();
+}
+
+bool Proof::loadText()
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = "Could not open file for reading";
+        return false;
+    }
+    QTextStream in(&file);
+    QString error;
+    rule = QSharedPointer<Rule>(Rule::fromStr(in.readLine(), &error));
+    if (rule.isNull()) {
+        lastError = "Invalid rule: " + error;
+        file.close();
+        return false;
+    }
+    QString s;
+    int n, i;
+    while (in >> s, s != "IDX") {
+        if (in.atEnd()) {
+            lastError = "Unexpected end of file";
+            file.close();
+            return false;
+        }
+        Step step;
+        if (!(step.output = Expression::fromStr(s, &error))) {
+            lastError = "Invalid formula: " + error;
+            file.close();
+            return false;
+        }
+        in >> s;
+        s.replace("%20", " ");
+        step.rule = s;
+        step.basicRule = getBasicRule(s);
+        in >> n;
+        step.usedInputs.reserve(n);
+        for (int j = n; j--;) {
+            in >> i;
+            step.usedInputs.append(i);
+        }
+        in >> step.clIndex >> step.indentation;
+        while (in >> s, s != "END_STEP") {
+            if (in.atEnd()) {
+                lastError = "Unexpected end of file";
+                file.close();
+                return false;
+            }
+            const Expression *value;
+            if (((i = s.indexOf(':')) < 0) || !(value = Expression::fromStr(s.mid(i + 1)))) {
+                lastError = "Wrong renaming rule";
+                file.close();
+                return false;
+            }
+            step.renaming[s.left(i)] = value;
+        }
+        steps.append(step);
+    }
+    in >> n;
+    stepIndexes.reserve(n);
+    for (int j = n; j--;) {
+        in >> i;
+        stepIndexes.append(i);
+    }
+    file.close();
+    return true;
+}
+
+bool Proof::loadBinary()
+{
+    BinaryProof binary(filename);
+    if (!binary.isValid()) {
+        lastError = binary.getLastError();
+        return false;
+    }
+    rule = binary.getRule();
+    int n = binary.getStepCount();
+    steps.reserve(n);
+    for (int i = 0; i < n; ++i)
+        steps.append(binary.getStep(i));
+    stepIndexes = binary.getStepIndexes();
+    return true;
+}
+
+bool Proof::saveToFile(QString filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        lastError = "Could not open file for writing";
+        return false;
+    }
+    /* The whole file is written to one buffer first: */
+    QString text = rule->getStr();
+    text += QLatin1Char('\n');
+    for (int i = 0; i < steps.size(); ++i) {
+        const Step &currentStep = steps[i];
+        currentStep.output->writeStr(text);
+        QString ruleModif = currentStep.rule;
+        ruleModif.replace(" ", "%20");
+        text += QLatin1Char(' ') + ruleModif + QLatin1Char(' ') + QString::number(currentStep.usedInputs.size()) + QLatin1Char(' ');
+        for (int j = 0; j < currentStep.usedInputs.size(); ++j)
+            text += QString::number(currentStep.usedInputs[j]) + QLatin1Char(' ');
+        text += QString::number(currentStep.clIndex) + QLatin1Char(' ') + QString::number(currentStep.indentation) + QLatin1Char(' ');
+        QMap<QString, const Expression *>::const_iterator it = currentStep.renaming.constBegin();
+        while (it != currentStep.renaming.constEnd()) {
+            text += it.key() + QLatin1Char(':');
+            it.value()->writeStr(text);
+            text += QLatin1Char(' ');
+            ++it;
+        }
+        text += QStringLiteral("END_STEP\n");
+    }
+    text += QStringLiteral("IDX ") + QString::number(stepIndexes.size());
+    for (int i = 0; i < stepIndexes.size(); ++i)
+        text += QLatin1Char(' ') + QString::number(stepIndexes[i]);
+    text += QLatin1Char('\n');
+    file.write(text.toLocal8Bit());
+    file.close();
+    return true;
+}
+
+bool Proof::saveToBinaryFile(QString filename) const
+{
+    return BinaryProof::write(filename, *rule, steps, stepIndexes, lastError);
+}
+
+bool Proof::isCorrect() const
+{
+    return ok;
+}
+
+bool Proof::isFinished() const
+{
+    return finished;
+}
+
+QString Proof::getLastError() const
+{
+    return lastError;
+}
+
+QSharedPointer<Rule> Proof::getRule() const
+{
+    return rule;
+}
+
+static void addLemma(QStringList &lemmas, const QString &rule, const QString &baseDir)
+{
+    if (rule.startsWith(':') || (rule == "-"))
+        return;
+    QString lemma = LemmaCache::resolve(rule, baseDir);
+    if (!lemmas.contains(lemma))
+        lemmas.append(lemma);
+}
+
+QStringList Proof::getLemmas() const
+{
+    QStringList result;
+    QString baseDir = filename.isEmpty() ? QString() : QFileInfo(filename).absolutePath();
+    foreach (const Step &step, steps)
+        addLemma(result, step.rule, baseDir);
+    return result;
+}
+
+/* Follows the layout read by loadText() and loadBinary(), and stops at the first error: */
+QStringList Proof::scanLemmas(const QString &filename)
+{
+    QStringList result;
+    QString baseDir = QFileInfo(filename).absolutePath();
+    if (BinaryProof::isBinaryFile(filename)) {
+        BinaryProof binary(filename, false);
+        if (binary.isValid()) {
+            for (int i = 0; i < binary.getStepCount(); ++i)
+                addLemma(result, binary.getStepRule(i), baseDir);
+        }
+        return result;
+    }
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    QTextStream in(&file);
+    in.readLine();
+    QString s;
+    int n, i;
+    while (in >> s, (s != "IDX") && !in.atEnd()) {
+        in >> s;
+        s.replace("%20", " ");
+        addLemma(result, s, baseDir);
+        in >> n;
+        for (int j = n; j-- > 0;)
+            in >> i;
+        in >> i >> i;
+        while (in >> s, (s != "END_STEP") && !in.atEnd()) {}
+    }
+    file.close();
+    return result;
+}
+
+int Proof::getStepCount() const
+{
+    return steps.size();
+}
+
+const Step &Proof::getStep(int index) const
+{
+    return steps.at(index);
+}
+
+bool Proof::isStepValid(int index) const
+{
+    return (index >= 0) && (index < stepValid.size()) && stepValid[index];
+}
+
+QString Proof::getStepError(int index) const
+{
+    return stepErrors.value(index);
+}
+
+const ProofProfile &Proof::getProfile() const
+{
+    return profile;
+}
+
+static QString formatNsecs(qint64 nsecs)
+{
+    return QString::number(nsecs / 1e6, 'f', 3) + " ms";
+}
+
+QString Proof::getProfileReport(int count) const
+{
+    if (!ProofProfile::isEnabled())
+        return "Profiling is not compiled in (qmake CONFIG+=proof_profile).\n";
+    QString report;
+    report += QString("Load %1, scopes %2, steps %3\n").arg(formatNsecs(profile.loadNsecs),
+            formatNsecs(profile.scopeNsecs), formatNsecs(profile.stepsNsecs));
+    report += QString("%1 lemma loads, %2 adapt calls, %3 matches, %4 nodes allocated, %5 bytes serialized\n")
+            .arg(profile.lemmaLoads).arg(profile.adaptCalls).arg(profile.matchCalls)
+            .arg(profile.nodesAllocated).arg(profile.bytesSerialized);
+
+    QList<QPair<qint64, QString> > rules;
+    QHash<QString, ProofProfile::Timing>::const_iterator rule;
+    for (rule = profile.ruleTimes.constBegin(); rule != profile.ruleTimes.constEnd(); ++rule)
+        rules.append(qMakePair(rule.value().nsecs, rule.key()));
+    qSort(rules.begin(), rules.end(), qGreater<QPair<qint64, QString> >());
+    report += "Time per rule:\n";
+    for (int i = 0; i < rules.size(); ++i) {
+        report += QString("  %1: %2 steps, %3\n").arg(rules[i].second)
+                .arg(profile.ruleTimes.value(rules[i].second).count).arg(formatNsecs(rules[i].first));
+    }
+
+    QVector<QPair<qint64, int> > slowSteps;
+    slowSteps.reserve(profile.stepNsecs.size());
+    for (int i = 0; i < profile.stepNsecs.size(); ++i)
+        slowSteps.append(qMakePair(profile.stepNsecs[i], i));
+    qSort(slowSteps.begin(), slowSteps.end(), qGreater<QPair<qint64, int> >());
+    report += "Slowest steps:\n";
+    for (int i = 0; (i < count) && (i < slowSteps.size()); ++i) {
+        int index = slowSteps[i].second;
+        report += QString("  %1 (%2): %3\n").arg(index).arg((index < steps.size()) ? steps[index].rule : QString("?"),
+                                                            formatNsecs(slowSteps[i].first));
+    }
+
+    QList<QPair<qint64, QString> > slowLemmas;
+    QHash<QString, qint64>::const_iterator lemma;
+    for (lemma = profile.lemmaNsecs.constBegin(); lemma != profile.lemmaNsecs.constEnd(); ++lemma)
+        slowLemmas.append(qMakePair(lemma.value(), lemma.key()));
+    qSort(slowLemmas.begin(), slowLemmas.end(), qGreater<QPair<qint64, QString> >());
+    report += "Slowest lemmas:\n";
+    for (int i = 0; (i < count) && (i < slowLemmas.size()); ++i)
+        report += QString("  %1: %2\n").arg(slowLemmas[i].second, formatNsecs(slowLemmas[i].first));
+    return report;
+}
+
+static inline const Expression *stepOutput(const QList<Step> &steps, int index)
+{
+    return steps[index].output;
+}
+
+static inline const Expression *stepOutput(const QVector<const Expression *> &outputs, int index)
+{
+    return outputs[index];
+}
+
+/*
+ * Rule applied by a step: a basic rule, or a lemma, taken from the cache once per verification
+ * and held by lemmaMemo until the next one:
+ */
+static const Rule *getStepRule(const Step &step, const QString &filename,
+                               QHash<QString, ProofLemma> &lemmaMemo, QString &error)
+{
+    if (step.basicRule != NoBasicRule)
+        return getBasicRuleTrees()[step.basicRule].data();
+    if (step.rule.startsWith(':')) {
+        error = QObject::tr("Unrecognized rule \"%1\".").arg(step.rule);
+        return NULL;
+    }
+    if (!lemmaMemo.contains(step.rule)) {
+        PROFILE(QElapsedTimer lemmaTimer; lemmaTimer.start();)
+        QString baseDir = filename.isEmpty() ? QString() : QFileInfo(filename).absolutePath();
+        LemmaCache::Lemma lemma = LemmaCache::get(LemmaCache::resolve(step.rule, baseDir));
+        ProofLemma used;
+        if (lemma.status == LemmaCache::Verified)
+            used.rule = lemma.rule;
+        used.error = lemma.error;
+        used.entry = lemma.entry;
+        lemmaMemo.insert(step.rule, used);
+        PROFILE(ProofProfile *current = currentProfile(); if (current) current->addLemma(step.rule, lemmaTimer.nsecsElapsed());)
+    }
+    const ProofLemma &lemma = lemmaMemo[step.rule];
+    if (lemma.rule.isNull())
+        error = lemma.error;
+    return lemma.rule.data();
+}
+
+/*
+ * Checks step index of a proof of proofRule, given the outputs of the steps
+ * before it and the scopes up to it. The step is checked against the instance
+ * of the rule it applies, which is not built:
+ */
+template<class Outputs>
+static bool checkStep(const Step &step, int index, const Rule &proofRule, const Outputs &outputs, const ScopeTracker &scopes,
+                      const QString &filename, QHash<QString, ProofLemma> &lemmaMemo, QString &error)
+{
+    if (step.indentation != scopes.getDepth(index)) {
+        error = QObject::tr("Wrong indentation.");
+        return false;
+    }
+    QList<const Expression *> premises = proofRule.getPremises();
+    if (index < premises.size()) {
+        if (premises[index] != step.output) {
+            error = QObject::tr("The step does not match the premise of the proof.");
+            return false;
+        }
+        return true;
+    }
+    const Rule *subRule = getStepRule(step, filename, lemmaMemo, error);
+    if (!subRule)
+        return false;
+    Substitution substitution(step.renaming);
+    premises = subRule->getPremises();
+    if (premises.size() != step.usedInputs.size()) {
+        error = QObject::tr("Wrong number of inputs.");
+        return false;
+    }
+    for (int j = premises.size(); j-- > 0;) {
+        int input = step.usedInputs[j];
+        if ((input < 0) || (input >= index) || !scopes.isVisible(input, index)) {
+            error = QObject::tr("Input %1 is not available.").arg(j + 1);
+            return false;
+        }
+        PROFILE_COUNT(matchCalls, 1);
+        if (!substitution.maps(premises[j], stepOutput(outputs, input))) {
+            error = QObject::tr("Input %1 does not match the rule.").arg(j + 1);
+            return false;
+        }
+    }
+    if ((step.clIndex < 0) || (step.clIndex >= subRule->getConclusions().size())) {
+        error = QObject::tr("Wrong conclusion index.");
+        return false;
+    }
+    PROFILE_COUNT(matchCalls, 1);
+    if (!substitution.maps(subRule->getConclusions().at(step.clIndex), step.output)) {
+        error = QObject::tr("The output does not match the rule.");
+        return false;
+    }
+    if ((step.basicRule == IntroArrowRule) || (step.basicRule == RAARule)) {
+        int opener = scopes.getBound(index);
+        if ((opener < 0) || (scopes.getAssumption(opener) != step.renaming.value("X"))) {
+            error = QObject::tr("The closed scope does not start with the matching assumption.");
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Whether the steps of the indexes give the conclusions of the rule at the top level, where the proof ends: */
+template<class Outputs>
+static bool concludes(const Rule &proofRule, const Outputs &outputs, int lastIndentation, const ScopeTracker &scopes,
+                      const QList<int> &stepIndexes)
+{
+    QList<const Expression *> conclusions = proofRule.getConclusions();
+    int n = scopes.getStepCount();
+    if (!n || lastIndentation)
+        return false;
     if (stepIndexes.size() != conclusions.size())
         return false;
     for (int i = conclusions.size(); i-- > 0;) {
-        if ((stepIndexes[i] < 0) || (stepIndexes[i] >= steps.size()))
+        if ((stepIndexes[i] < 0) || (stepIndexes[i] >= n))
             return false;
-        if (steps[stepIndexes[i]].output != conclusions[i]->getStr())
+        if (stepOutput(outputs, stepIndexes[i]) != conclusions[i])
             return false;
+        if (scopes.getScope(stepIndexes[i]) >= 0)
+            return false;
+    }
+    return true;
+}
+
+/* Maps a step index after an edition to the index it had before (-1 for an inserted step): */
+static inline int oldIndex(int index, int edited, int shift)
+{
+    if (index < edited)
+        return index;
+    if (shift > 0)
+        return (index == edited) ? -1 : index - 1;
+    return index - shift;
+}
+
+QList<int> Proof::insertStep(int index, const Step &step)
+{
+    if (rule.isNull() || (index < rule->getPremises().size()) || (index > steps.size()))
+        return QList<int>();
+    QVector<bool> oldValid = stepValid;
+    ScopeTracker oldScopes = scopes;
+    steps.insert(index, step);
+    steps[index].basicRule = getBasicRule(step.rule);
+    for (int i = 0; i < steps.size(); ++i) {
+        QList<int> &inputs = steps[i].usedInputs;
+        for (int j = 0; j < inputs.size(); ++j) {
+            if ((i != index) && (inputs[j] >= index))
+                ++inputs[j];
+        }
+    }
+    for (int i = 0; i < stepIndexes.size(); ++i) {
+        if (stepIndexes[i] >= index)
+            ++stepIndexes[i];
+    }
+    if (!verified)
+        return QList<int>();
+    stepValid.insert(index, false);
+    stepErrors.insert(index, QString());
+    if (index <= profile.stepNsecs.size())
+        profile.stepNsecs.insert(index, 0);
+    QSet<int> dirty;
+    dirty.insert(index);
+    return reverify(index, 1, ScopeTracker::isScopeRule(steps[index].basicRule), dirty, oldValid, oldScopes);
+}
+
+QList<int> Proof::removeStep(int index)
+{
+    if (rule.isNull() || (index < rule->getPremises().size()) || (index >= steps.size()))
+        return QList<int>();
+    QVector<bool> oldValid = stepValid;
+    ScopeTracker oldScopes = scopes;
+    QSet<int> dirty;
+    foreach (int dependent, dependents.value(index)) {
+        if (dependent > index)
+            dirty.insert(dependent - 1);
+    }
+    bool scopeChanged = ScopeTracker::isScopeRule(steps[index].basicRule);
+    steps.removeAt(index);
+    for (int i = 0; i < steps.size(); ++i) {
+        QList<int> &inputs = steps[i].usedInputs;
+        for (int j = 0; j < inputs.size(); ++j) {
+            if (inputs[j] == index)
+                inputs[j] = -1;
+            else if (inputs[j] > index)
+                --inputs[j];
+        }
+    }
+    for (int i = 0; i < stepIndexes.size(); ++i) {
+        if (stepIndexes[i] == index)
+            stepIndexes[i] = -1;
+        else if (stepIndexes[i] > index)
+            --stepIndexes[i];
+    }
+    if (!verified)
+        return QList<int>();
+    if (!stepValid[index])
+        --invalidCount;
+    stepValid.remove(index);
+    stepErrors.remove(index);
+    if (index < profile.stepNsecs.size())
+        profile.stepNsecs.remove(index);
+    return reverify(index, -1, scopeChanged, dirty, oldValid, oldScopes);
+}
+
+QList<int> Proof::replaceStep(int index, const Step &step)
+{
+    if (rule.isNull() || (index < rule->getPremises().size()) || (index >= steps.size()))
+        return QList<int>();
+    QVector<bool> oldValid = stepValid;
+    ScopeTracker oldScopes = scopes;
+    QSet<int> dirty;
+    dirty.insert(index);
+    if (step.output != steps[index].output) {
+        foreach (int dependent, dependents.value(index))
+            dirty.insert(dependent);
+    }
+    bool scopeChanged = ScopeTracker::isScopeRule(steps[index].basicRule);
+    steps[index] = step;
+    steps[index].basicRule = getBasicRule(step.rule);
+    scopeChanged = scopeChanged || ScopeTracker::isScopeRule(steps[index].basicRule);
+    if (!verified)
+        return QList<int>();
+    return reverify(index, 0, scopeChanged, dirty, oldValid, oldScopes);
+}
+
+QList<int> Proof::edit(const ProofEdit &edit)
+{
+    switch (edit.kind) {
+    case ProofEdit::InsertStep:
+        return insertStep(edit.index, edit.step);
+    case ProofEdit::RemoveStep:
+        return removeStep(edit.index);
+    case ProofEdit::ReplaceStep:
+        return replaceStep(edit.index, edit.step);
+    }
+    return QList<int>();
+}
+
+QList<int> Proof::reverify(int edited, int shift, bool scopeChanged, QSet<int> dirty,
+                           const QVector<bool> &oldValid, const ScopeTracker &oldScopes)
+{
+    int n = steps.size();
+    PROFILE_SCOPE();
+    /* The lemmas of the previous verification stay in the cache until this one has got them again: */
+    QHash<QString, ProofLemma> previousLemmas = lemmaMemo;
+    lemmaMemo.clear();
+    PROFILE(QElapsedTimer scopeTimer; scopeTimer.start();)
+    computeScopes();
+    PROFILE(profile.scopeNsecs += scopeTimer.nsecsElapsed();)
+    dependents.fill(QList<int>(), n);
+    for (int i = 0; i < n; ++i) {
+        foreach (int j, steps[i].usedInputs) {
+            if ((j >= 0) && (j < i))
+                dependents[j].append(i);
+        }
+    }
+    if (scopeChanged) {
+        /* Only steps whose depth, scope, assumption or input accessibility changed need to be checked again: */
+        for (int i = edited; i < n; ++i) {
+            int o = oldIndex(i, edited, shift);
+            if ((o < 0) || (scopes.getDepth(i) != oldScopes.getDepth(o))) {
+                dirty.insert(i);
+                continue;
+            }
+            if ((steps[i].basicRule == IntroArrowRule) || (steps[i].basicRule == RAARule)) {
+                int bound = scopes.getBound(i);
+                int opener = (bound < 0) ? -1 : oldIndex(bound, edited, shift);
+                if (((bound >= 0) && (opener < 0)) || (opener != oldScopes.getBound(o))
+                        || ((opener >= 0) && (scopes.getAssumption(bound) != oldScopes.getAssumption(opener)))) {
+                    dirty.insert(i);
+                    continue;
+                }
+            }
+            foreach (int j, steps[i].usedInputs) {
+                if ((j < 0) || (j >= i))
+                    continue;
+                int oj = oldIndex(j, edited, shift);
+                if ((oj < 0) || (scopes.isVisible(j, i) != oldScopes.isVisible(oj, o))) {
+                    dirty.insert(i);
+                    break;
+                }
+            }
+        }
+    }
+    QList<int> changed;
+    foreach (int i, dirty) {
+        int o = oldIndex(i, edited, shift);
+        bool before = (o >= 0) && (o < oldValid.size()) && oldValid[o];
+        PROFILE(QElapsedTimer stepTimer; stepTimer.start();)
+        bool after = verifyStep(i);
+        PROFILE(profile.addStep(i, steps[i].rule, stepTimer.nsecsElapsed());)
+        if ((o < 0) || (o >= oldValid.size()))
+            invalidCount += after ? 0 : 1;
+        else if (before != after)
+            invalidCount += after ? -1 : 1;
+        stepValid[i] = after;
+        if ((o < 0) || (before != after))
+            changed.append(i);
+    }
+    qSort(changed);
+    updateVerdict();
+    return changed;
+}
+
+void Proof::updateVerdict()
+{
+    lastError.clear();
+    if (invalidCount) {
+        for (int i = 0; i < stepValid.size(); ++i) {
+            if (!stepValid[i]) {
+                lastError = stepErrors[i];
+                break;
+            }
+        }
     }
+    ok = !invalidCount && (steps.size() >= rule->getPremises().size());
+    finished = ok && verifyFinished();
+}
+
+bool Proof::verify(VerificationObserver *observer)
+{
+    finished = false;
+    if (rule.isNull())
+        return false;
+    ok = verifyCorrect(observer);
+    if (!verified)
+        return false;
+    if (ok)
+        finished = verifyFinished();
     return true;
 }
+
+bool Proof::isVerified() const
+{
+    return verified;
+}
+
+void Proof::clearVerification()
+{
+    ok = finished = verified = false;
+    stepValid.clear();
+    stepErrors.clear();
+    dependents.clear();
+    invalidCount = 0;
+    lastError.clear();
+}
+
+bool Proof::verifyCorrect(VerificationObserver *observer) const
+{
+    int n = steps.size();
+    verified = false;
+    PROFILE_SCOPE();
+    QHash<QString, ProofLemma> previousLemmas = lemmaMemo;
+    lemmaMemo.clear();
+    PROFILE(QElapsedTimer scopeTimer; scopeTimer.start();)
+    computeScopes();
+    PROFILE(profile.scopeNsecs += scopeTimer.nsecsElapsed();)
+    PROFILE(profile.stepNsecs.fill(0, n);)
+    stepValid.fill(false, n);
+    stepErrors.fill(QString(), n);
+    dependents.fill(QList<int>(), n);
+    invalidCount = 0;
+    lastError.clear();
+    if (n < rule->getPremises().size()) {
+        lastError = QObject::tr("Some premises are missing.");
+        verified = true;
+        return false;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (observer && !(i % VERIFICATION_PROGRESS_STEPS) && !observer->stepsChecked(i, n)) {
+            stepValid.clear();
+            stepErrors.clear();
+            dependents.clear();
+            invalidCount = 0;
+            lastError = QObject::tr("The verification was cancelled.");
+            return false;
+        }
+        foreach (int j, steps[i].usedInputs) {
+            if ((j >= 0) && (j < i))
+                dependents[j].append(i);
+        }
+        PROFILE(QElapsedTimer stepTimer; stepTimer.start();)
+        stepValid[i] = verifyStep(i);
+        PROFILE(profile.addStep(i, steps[i].rule, stepTimer.nsecsElapsed());)
+        if (!stepValid[i]) {
+            if (!invalidCount++)
+                lastError = stepErrors[i];
+        }
+    }
+    if (observer)
+        observer->stepsChecked(n, n);
+    verified = true;
+    return !invalidCount;
+}
+
+bool Proof::verifyFinished() const
+{
+    return concludes(*rule, steps, steps.isEmpty() ? 0 : steps.last().indentation, scopes, stepIndexes);
+}
+
+bool Proof::verifyStep(int index) const
+{
+    QString &error = stepErrors[index];
+    error.clear();
+    return checkStep(steps[index], index, *rule, steps, scopes, filename, lemmaMemo, error);
+}
+
+void Proof::computeScopes() const
+{
+    scopes.clear();
+    scopes.reserve(steps.size());
+    foreach (const Step &step, steps)
+        scopes.append(step);
+}
+
+ProofStream::ProofStream(QSharedPointer<Rule> rule, const QString &filename)
+    : rule(rule), filename(filename), invalidCount(0), lastIndentation(0), finished(false)
+{
+}
+
+/* A text proof is parsed into steps anyway, so it is verified by Proof: */
+ProofStream::ProofStream(const QString &filename) : filename(filename), invalidCount(0), lastIndentation(0), finished(false)
+{
+    PROFILE_SCOPE();
+    if (!BinaryProof::isBinaryFile(filename)) {
+        Proof proof(filename);
+        rule = proof.getRule();
+        if (!proof.isCorrect())
+            invalidCount = 1;
+        finished = proof.isFinished();
+        lastError = proof.getLastError();
+        for (int i = 0; i < proof.getStepCount(); ++i) {
+            const Step &step = proof.getStep(i);
+            if ((step.basicRule == NoBasicRule) && !lemmaRules.contains(step.rule))
+                lemmaRules.append(step.rule);
+        }
+        return;
+    }
+    BinaryProof binary(filename);
+    if (!binary.isValid()) {
+        invalidCount = 1;
+        lastError = binary.getLastError();
+        return;
+    }
+    rule = binary.getRule();
+    int n = binary.getStepCount();
+    reserve(n);
+    Step step;
+    for (int i = 0; i < n; ++i) {
+        binary.readStep(i, step);
+        append(step);
+    }
+    finish(binary.getStepIndexes());
+}
+
+void ProofStream::reserve(int stepCount)
+{
+    outputs.reserve(stepCount);
+    scopes.reserve(stepCount);
+}
+
+bool ProofStream::append(const Step &step)
+{
+    if ((step.basicRule == NoBasicRule) && !lemmaMemo.contains(step.rule) && !lemmaRules.contains(step.rule))
+        lemmaRules.append(step.rule);
+    int index = scopes.append(step);
+    QString error;
+    bool valid = checkStep(step, index, *rule, outputs, scopes, filename, lemmaMemo, error);
+    outputs.append(step.output);
+    lastIndentation = step.indentation;
+    if (!valid && !invalidCount++)
+        lastError = error;
+    return valid;
+}
+
+bool ProofStream::finish(const QList<int> &stepIndexes)
+{
+    if ((outputs.size() < rule->getPremises().size()) && !invalidCount++)
+        lastError = QObject::tr("Some premises are missing.");
+    finished = !invalidCount && concludes(*rule, outputs, lastIndentation, scopes, stepIndexes);
+    return finished;
+}
+
+bool ProofStream::isCorrect() const
+{
+    return !invalidCount;
+}
+
+bool ProofStream::isFinished() const
+{
+    return finished;
+}
+
+int ProofStream::getStepCount() const
+{
+    return outputs.size();
+}
+
+QString ProofStream::getLastError() const
+{
+    return lastError;
+}
+
+QSharedPointer<Rule> ProofStream::getRule() const
+{
+    return rule;
+}
+
+QStringList ProofStream::getLemmas() const
+{
+    QStringList result;
+    QString baseDir = filename.isEmpty() ? QString() : QFileInfo(filename).absolutePath();
+    foreach (const QString &lemma, lemmaRules)
+        addLemma(result, lemma, baseDir);
+    return result;
+}
@@ -4,137 +4,461 @@
 #include <QString>
 #include <QSharedPointer>
 #include <QSet>
+#include <QMap>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QAtomicPointer>
+
+/*
+ * Expressions are immutable and hash-consed: every node is created through
+ * ExprFactory, which returns the unique node for a given structure. Two
+ * expressions are therefore equal if and only if they are the same pointer.
+ * Nodes are owned by the factory and live as long as the process: they are
+ * bump-allocated from an arena and never deleted, and children are plain
+ * non-owning pointers. Traversals use explicit stacks, so that the depth of an
+ * expression is only limited by memory.
+ */
+struct ExprText;
+
+/*
+ * Set of variables, by the identifier the factory interns each name to: a
+ * bitset whose first 64 bits are stored inline, the others in an implicitly
+ * shared array, so that copies are cheap and most sets never allocate.
+ */
+class VarSet
+{
+public:
+    VarSet();
+    bool isEmpty() const;
+    int count() const;
+    /* Bound on the identifiers of the set, a multiple of 64: */
+    int getCapacity() const;
+    bool contains(int id) const;
+    bool contains(const VarSet &other) const;
+    bool intersects(const VarSet &other) const;
+    void insert(int id);
+    QList<int> getIds() const;
+    QSet<QString> getNames() const;
+    VarSet &operator|=(const VarSet &other);
+    VarSet operator|(const VarSet &other) const;
+    bool operator==(const VarSet &other) const;
+    bool operator!=(const VarSet &other) const;
+private:
+    quint64 low;
+    /* Words of the identifiers from 64 on, without trailing zero words: */
+    QVector<quint64> high;
+};
 
 class Expression
 {
 public:
-    virtual QString getStr(bool bracketized = false) const = 0;
-    virtual QSet<QString> getVariables() const = 0;
-    virtual QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const = 0;
-    virtual int getLevel() const = 0;
+    enum Kind { Variable, NOT, OR, AND, Imply, Equiv };
+public:
+    virtual ~Expression() {}
+    Kind getKind() const;
+    uint getHash() const;
+    int getChildCount() const;
+    virtual const Expression *getChild(int index) const;
+    /* Flattened view: the operands x1, ..., xn of a chain x1&(x2&(...&xn)) or x1|(x2|(...|xn)), the children otherwise: */
+    int getOperandCount() const;
+    const Expression *getOperand(int index) const;
+    QString getStr(bool bracketized = false) const;
+    int getStrLength(bool bracketized = false) const;
+    void writeStr(QString &out, bool bracketized = false) const;
+    uint getStrHash() const;
+    /* Variables of the expression, precomputed when the node is built: */
+    VarSet getVariableSet() const;
+    bool hasVariableIn(const VarSet &set) const;
+    QSet<QString> getVariables() const;
+    const Expression *replaceVariableNames(const QMap<QString, const Expression *> &renaming) const;
+    int getLevel() const;
     QString getLevelCompliantStr(int maxLevel, bool bracketized = false) const;
 public:
-    static Expression *fromStr(const QString &str);
+    /* Accepts the connectives ~ | & > = as well as their usual symbols (¬ ∨ ∧ → ↔ and variants): */
+    static const Expression *fromStr(const QString &str, QString *error = NULL, int *errorPosition = NULL);
+protected:
+    /* The variables of a node are those of its children e1 and e2: */
+    Expression(Kind kind, uint hash, const Expression *e1 = NULL, const Expression *e2 = NULL);
+protected:
+    VarSet variables;
+private:
+    static int serialize(const Expression *root, bool bracketized, QChar *out);
 private:
-    static Expression *fromStrAux(const QString &str, int start, int maxLevel, int &end);
+    Kind kind;
+    uint hash;
+    mutable QAtomicPointer<ExprText> strCache;
+    /* False when the set was too large to be stored, see getVariableSet(): */
+    bool variablesStored;
 };
 
 class ExprVar : public Expression
 {
+    friend class ExprFactory;
 public:
-    ExprVar(QString variableName);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    const QString &getName() const;
+    int getId() const;
+private:
+    ExprVar(const QString &variableName, int id);
 private:
     QString varName;
+    int varId;
 };
 
 class ExprNOT : public Expression
 {
+    friend class ExprFactory;
 public:
-    ExprNOT(Expression *e);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    const Expression *getChild(int index) const;
+private:
+    ExprNOT(const Expression *e);
 private:
-    QSharedPointer<Expression> e;
+    const Expression *e;
 };
 
-class ExprOR : public Expression
+struct OperandBlock;
+
+/*
+ * Conjunctions and disjunctions are flattened along their right operand: the
+ * operands of x1&(x2&(...&xn)) are stored contiguously (last first), in a block
+ * shared with the nodes of the inner chains, which grows in place as long as
+ * the chain is built from its innermost node. The binary view is unchanged:
+ * the children are x1 and the node of x2&(...&xn), so that (a&b)&c and a&(b&c)
+ * remain distinct.
+ */
+class ExprNary : public Expression
 {
+    friend class Expression;
 public:
-    ExprOR(Expression *e1, Expression *e2);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    const Expression *getChild(int index) const;
+protected:
+    ExprNary(Kind kind, const Expression *e1, const Expression *e2);
 private:
-    QSharedPointer<Expression> e1, e2;
+    const Expression *head, *tail;
+    /* Operands of chains longer than two, NULL otherwise: */
+    OperandBlock *block;
+    int count;
 };
 
-class ExprAND : public Expression
+class ExprOR : public ExprNary
 {
-public:
-    ExprAND(Expression *e1, Expression *e2);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    friend class ExprFactory;
 private:
-    QSharedPointer<Expression> e1, e2;
+    ExprOR(const Expression *e1, const Expression *e2);
+};
+
+class ExprAND : public ExprNary
+{
+    friend class ExprFactory;
+private:
+    ExprAND(const Expression *e1, const Expression *e2);
 };
 
 class ExprImply : public Expression
 {
+    friend class ExprFactory;
 public:
-    ExprImply(Expression *e1, Expression *e2);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    const Expression *getChild(int index) const;
+private:
+    ExprImply(const Expression *e1, const Expression *e2);
 private:
-    QSharedPointer<Expression> e1, e2;
+    const Expression *e1, *e2;
 };
 
 class ExprEquiv : public Expression
 {
+    friend class ExprFactory;
 public:
-    ExprEquiv(Expression *e1, Expression *e2);
-    QString getStr(bool bracketized = false) const;
-    QSet<QString> getVariables() const;
-    QSharedPointer<Expression> replaceVariableNames(QMap<QString, QSharedPointer<Expression> > renaming) const;
-    int getLevel() const;
+    const Expression *getChild(int index) const;
+private:
+    ExprEquiv(const Expression *e1, const Expression *e2);
 private:
-    QSharedPointer<Expression> e1, e2;
+    const Expression *e1, *e2;
+};
+
+class ExprFactory
+{
+public:
+    /* Memory held by the nodes: bytes taken by the nodes themselves, and reserved by the arena: */
+    struct Stats
+    {
+        int nodeCount;
+        qint64 nodeBytes, arenaBytes;
+    };
+public:
+    static const Expression *makeVar(const QString &variableName);
+    static const Expression *makeNOT(const Expression *e);
+    static const Expression *makeOR(const Expression *e1, const Expression *e2);
+    static const Expression *makeAND(const Expression *e1, const Expression *e2);
+    static const Expression *makeImply(const Expression *e1, const Expression *e2);
+    static const Expression *makeEquiv(const Expression *e1, const Expression *e2);
+    static const Expression *make(Expression::Kind kind, const Expression *e1, const Expression *e2 = NULL);
+    /* Variables are numbered densely in the order their names are first seen: */
+    static const ExprVar *getVar(int id);
+    /* Identifier of an existing variable, -1 if no expression uses the name: */
+    static int findVar(const QString &variableName);
+    static int getVarCount();
+    static Stats getStats();
+};
+
+/*
+ * Renaming compiled to an array indexed by variable identifier. Subformulas
+ * without renamed variables are returned as they are, without being walked,
+ * and the rebuilt ones are remembered, so that the subterms shared by the
+ * formulas a substitution is applied to are only rebuilt once.
+ */
+class Substitution
+{
+public:
+    Substitution(const QMap<QString, const Expression *> &renaming);
+    const Expression *apply(const Expression *e);
+    /* Whether applying the substitution to the pattern gives the formula, without building the result: */
+    bool maps(const Expression *pattern, const Expression *formula) const;
+private:
+    /* Image of each variable, NULL for those left unchanged: */
+    QVector<const Expression *> images;
+    VarSet domain;
+    QHash<const Expression *, const Expression *> memo;
 };
 
 class Rule
 {
 public:
-    Rule(QList< QSharedPointer<Expression> > premises, QList< QSharedPointer<Expression> > conclusions);
+    Rule(QList<const Expression *> premises, QList<const Expression *> conclusions);
     QString getStr(bool bracketized = false) const;
-    QList< QSharedPointer<Expression> > getPremises() const;
-    QList< QSharedPointer<Expression> > getConclusions() const;
+    QList<const Expression *> getPremises() const;
+    QList<const Expression *> getConclusions() const;
     QSet<QString> getInputVariables() const;
     QSet<QString> getOutputVariables() const;
-    Rule *adapt(QMap<QString, QSharedPointer<Expression> > renaming) const;
+    const VarSet &getInputVariableSet() const;
+    const VarSet &getOutputVariableSet() const;
+    Rule *adapt(const QMap<QString, const Expression *> &renaming) const;
 public:
-    static Rule *fromStr(const QString &str);
+    static Rule *fromStr(const QString &str, QString *error = NULL);
 private:
-    QList< QSharedPointer<Expression> > premises, conclusions;
+    QList<const Expression *> premises, conclusions;
+    VarSet inputVariables, outputVariables;
+};
+
+/* Rules of the calculus, in the order of the table of proof.cpp: */
+enum BasicRule
+{
+    NoBasicRule = -1,
+    ElimAndRule, IntroAndRule, ElimOr1Rule, ElimOr2Rule, IntroOrRule, ElimArrowRule,
+    AssumeRule, IntroArrowRule, RAARule,
+    ElimEquivRule, IntroEquivRule, ConclusionRule,
+    BasicRuleCount
 };
 
 struct Step
 {
+    Step() : clIndex(0), output(NULL), indentation(0), basicRule(NoBasicRule) {}
     QString rule;
     QList<int> usedInputs;
-    QMap<QString, QString> renaming;
+    QMap<QString, const Expression *> renaming;
     int clIndex;
-    QString output;
+    const Expression *output;
     int indentation;
+    /* Resolved from rule by Proof::getBasicRule() when the step is loaded, NoBasicRule for a lemma: */
+    BasicRule basicRule;
+};
+
+/*
+ * Nesting of the :Assume scopes of a proof, recorded step by step. A scope
+ * spans from its :Assume to the :IntroArrow or :RAA closing it; the open ones
+ * form a stack, and each step records the innermost scope open at it, so that
+ * closing a scope takes constant time and whether a step is visible from a
+ * later one is read in constant time. A few integers are kept per step, and
+ * none of the steps themselves, so that they can be verified as they stream.
+ */
+class ScopeTracker
+{
+public:
+    ScopeTracker();
+    void clear();
+    void reserve(int stepCount);
+    /* Records the next step, and returns its index: */
+    int append(const Step &step);
+    int getStepCount() const;
+    /* Number of scopes open at the step, which is its expected indentation: */
+    int getDepth(int index) const;
+    /* Innermost :Assume step open at the step, -1 at the top level: */
+    int getScope(int index) const;
+    /* For an :Assume, its closing step (INT_MAX while open); for an :IntroArrow or :RAA,
+     * the :Assume it closes (-1 if none); -1 for the other steps: */
+    int getBound(int index) const;
+    /* Formula assumed by an :Assume step: */
+    const Expression *getAssumption(int index) const;
+    /* Whether the output of step j may be used by step i, for j < i: */
+    bool isVisible(int j, int i) const;
+public:
+    static bool isScopeRule(BasicRule rule);
+private:
+    QVector<int> depth, scope, bound;
+    QVector<int> open;
+    QHash<int, const Expression *> assumptions;
+};
+
+/*
+ * Where the time of a proof goes, recorded only when the core is built with
+ * AUBS_PROFILE (qmake CONFIG+=proof_profile); otherwise it stays empty and
+ * nothing is measured. Times are in nanoseconds. The totals cover the work
+ * done on the thread while the proof is loaded or verified, edits included,
+ * except for the lemmas it loads: their work goes to their own profile, and
+ * only the time taken to get each of them is recorded here. The time of each
+ * step is that of its last check.
+ */
+struct ProofProfile
+{
+    struct Timing
+    {
+        int count;
+        qint64 nsecs;
+    };
+    ProofProfile();
+    void addStep(int index, const QString &rule, qint64 nsecs);
+    void addLemma(const QString &lemma, qint64 nsecs);
+    static bool isEnabled();
+    qint64 loadNsecs, scopeNsecs, stepsNsecs;
+    qint64 lemmaLoads, adaptCalls, matchCalls, nodesAllocated, bytesSerialized;
+    QVector<qint64> stepNsecs;
+    /* Per basic rule (the lemmas are counted together), and per lemma: */
+    QHash<QString, Timing> ruleTimes;
+    QHash<QString, qint64> lemmaNsecs;
+};
+
+struct LemmaCacheEntry;
+
+/* Lemma used by a proof, which its entry keeps in the lemma cache as long as the proof holds it: */
+struct ProofLemma
+{
+    QSharedPointer<Rule> rule;
+    QString error;
+    QSharedPointer<const LemmaCacheEntry> entry;
+};
+
+/* Edition of a proof, to be replayed on another copy of it with Proof::edit(): */
+struct ProofEdit
+{
+    enum Kind { InsertStep, RemoveStep, ReplaceStep };
+    Kind kind;
+    int index;
+    /* Unused for a removal: */
+    Step step;
+};
+
+/* Follows a verification from another thread, and may cancel it: */
+class VerificationObserver
+{
+public:
+    virtual ~VerificationObserver() {}
+    /* Called every few steps and at the end; the verification stops when it returns false: */
+    virtual bool stepsChecked(int checked, int total) = 0;
 };
 
 class Proof
 {
 public:
     Proof(QSharedPointer<Rule> rule);
-    Proof(QString filename);
+    Proof(QSharedPointer<Rule> rule, const QList<Step> &steps, const QList<int> &stepIndexes, bool verify = true);
+    Proof(QString filename, bool verify = true);
     bool saveToFile(QString filename) const;
+    bool saveToBinaryFile(QString filename) const;
     bool isCorrect() const;
     bool isFinished() const;
+    QString getLastError() const;
     QSharedPointer<Rule> getRule() const;
+    QStringList getLemmas() const;
+    /* Lemmas of a proof file, found from the rules of its steps without reading its formulas: */
+    static QStringList scanLemmas(const QString &filename);
+    int getStepCount() const;
+    const Step &getStep(int index) const;
+    bool isStepValid(int index) const;
+    QString getStepError(int index) const;
+    const ProofProfile &getProfile() const;
+    /* Text report of the profile, with the count slowest steps and lemmas: */
+    QString getProfileReport(int count) const;
+    /* Verifies the proof, if it was loaded without being verified or its verification was cleared;
+     * returns false if there is no rule or the observer cancelled the verification: */
+    bool verify(VerificationObserver *observer = NULL);
+    bool isVerified() const;
+    /* Forgets the verdicts, but keeps a hold on the lemmas used: */
+    void clearVerification();
+    /* Edition functions; they return the steps whose verdict changed (new steps included).
+     * On a proof that is not verified, they only edit the steps: */
+    QList<int> insertStep(int index, const Step &step);
+    QList<int> removeStep(int index);
+    QList<int> replaceStep(int index, const Step &step);
+    QList<int> edit(const ProofEdit &edit);
+public:
+    static QMap<QString, QSharedPointer<Rule> > getBasicRules();
+    static BasicRule getBasicRule(const QString &name);
 private:
-    bool verifyCorrect() const;
+    bool loadText();
+    bool loadBinary();
+    bool verifyCorrect(VerificationObserver *observer = NULL) const;
     bool verifyFinished() const;
+    bool verifyStep(int index) const;
+    void computeScopes() const;
+    QList<int> reverify(int edited, int shift, bool scopeChanged, QSet<int> dirty,
+                        const QVector<bool> &oldValid, const ScopeTracker &oldScopes);
+    void updateVerdict();
 private:
+    QString filename;
     QSharedPointer<Rule> rule;
     QList<Step> steps;
     QList<int> stepIndexes;
     bool ok, finished;
+    mutable bool verified;
+    mutable QString lastError;
+    /* Verification state, one entry per step: */
+    mutable QVector<bool> stepValid;
+    mutable QVector<QString> stepErrors;
+    mutable QVector< QList<int> > dependents;
+    mutable int invalidCount;
+    mutable ScopeTracker scopes;
+    mutable QHash<QString, ProofLemma> lemmaMemo;
+    mutable ProofProfile profile;
+};
+
+/*
+ * Verification of a proof whose steps are given one at a time, in order,
+ * without keeping them: only the output of each step and the scopes are kept,
+ * so that a proof read from a file step by step never needs to be in memory.
+ * Lemmas are found relatively to the file of the proof, if any.
+ */
+class ProofStream
+{
+public:
+    ProofStream(QSharedPointer<Rule> rule, const QString &filename = QString());
+    /* Verifies the whole proof of a file; a binary one is decoded step by step into a single Step: */
+    ProofStream(const QString &filename);
+    void reserve(int stepCount);
+    /* Checks the next step, whose basic rule is resolved, and returns whether it is valid: */
+    bool append(const Step &step);
+    /* Checks, once all the steps are given, that the steps of the indexes conclude the rule: */
+    bool finish(const QList<int> &stepIndexes);
+    bool isCorrect() const;
+    bool isFinished() const;
+    int getStepCount() const;
+    /* Error of the first invalid step: */
+    QString getLastError() const;
+    QSharedPointer<Rule> getRule() const;
+    /* Same as Proof::getLemmas(), for the steps given so far: */
+    QStringList getLemmas() const;
+private:
+    QSharedPointer<Rule> rule;
+    QString filename;
+    QVector<const Expression *> outputs;
+    ScopeTracker scopes;
+    QHash<QString, ProofLemma> lemmaMemo;
+    /* Rules of the steps which are not basic rules, in order of first use: */
+    QStringList lemmaRules;
+    int invalidCount, lastIndentation;
+    bool finished;
     QString lastError;
+    ProofProfile profile;
 };
 
 #endif // PROOF_H
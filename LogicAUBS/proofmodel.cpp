@@ -0,0 +1,193 @@
+#include "proofmodel.h"
+
+#include <QStringList>
+#include <QBrush>
+#include <QColor>
+
+/* Background of the invalid steps: */
+#define INVALID_STEP_COLOR QColor(255, 224, 224)
+
+ProofModel::ProofModel(QObject *parent) : QAbstractTableModel(parent), proof(NULL) {}
+
+ProofModel::~ProofModel()
+{
+    delete proof;
+}
+
+void ProofModel::setProof(Proof *newProof)
+{
+    beginResetModel();
+    delete proof;
+    proof = newProof;
+    int n = proof ? proof->getStepCount() : 0;
+    verdicts.fill(UnknownVerdict, n);
+    errors.fill(QString(), n);
+    if (proof && proof->isVerified()) {
+        for (int i = 0; i < n; ++i) {
+            verdicts[i] = proof->isStepValid(i) ? ValidVerdict : InvalidVerdict;
+            errors[i] = proof->getStepError(i);
+        }
+        proof->clearVerification();
+    }
+    endResetModel();
+}
+
+const Proof *ProofModel::getProof() const
+{
+    return proof;
+}
+
+void ProofModel::setVerdicts(const Proof &verified)
+{
+    if (!proof || !verified.isVerified() || (verified.getStepCount() != proof->getStepCount()))
+        return;
+    QList<int> changed;
+    for (int i = 0; i < verdicts.size(); ++i) {
+        char verdict = verified.isStepValid(i) ? ValidVerdict : InvalidVerdict;
+        QString error = verified.getStepError(i);
+        if ((verdict != verdicts[i]) || (error != errors[i])) {
+            verdicts[i] = verdict;
+            errors[i] = error;
+            changed.append(i);
+        }
+    }
+    stepsChanged(changed);
+}
+
+/* The premises of the proof cannot be edited, and steps are only inserted up to the end: */
+bool ProofModel::isEditable(int row, bool inserting) const
+{
+    if (!proof || proof->getRule().isNull())
+        return false;
+    return (row >= proof->getRule()->getPremises().size()) && (row < proof->getStepCount() + (inserting ? 1 : 0));
+}
+
+bool ProofModel::insertStep(int row, const Step &step)
+{
+    if (!isEditable(row, true))
+        return false;
+    beginInsertRows(QModelIndex(), row, row);
+    proof->insertStep(row, step);
+    verdicts.insert(row, UnknownVerdict);
+    errors.insert(row, QString());
+    endInsertRows();
+    /* The inputs after the new step are renumbered: */
+    if (row + 1 < proof->getStepCount())
+        emit dataChanged(index(row + 1, InputsColumn), index(proof->getStepCount() - 1, InputsColumn));
+    stepEdited(ProofEdit::InsertStep, row, step);
+    return true;
+}
+
+bool ProofModel::removeStep(int row)
+{
+    if (!isEditable(row, false))
+        return false;
+    beginRemoveRows(QModelIndex(), row, row);
+    proof->removeStep(row);
+    verdicts.remove(row);
+    errors.remove(row);
+    endRemoveRows();
+    if (row < proof->getStepCount())
+        emit dataChanged(index(row, InputsColumn), index(proof->getStepCount() - 1, InputsColumn));
+    stepEdited(ProofEdit::RemoveStep, row, Step());
+    return true;
+}
+
+bool ProofModel::replaceStep(int row, const Step &step)
+{
+    if (!isEditable(row, false))
+        return false;
+    proof->replaceStep(row, step);
+    verdicts[row] = UnknownVerdict;
+    errors[row].clear();
+    emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+    stepEdited(ProofEdit::ReplaceStep, row, step);
+    return true;
+}
+
+void ProofModel::stepEdited(ProofEdit::Kind kind, int row, const Step &step)
+{
+    ProofEdit edit;
+    edit.kind = kind;
+    edit.index = row;
+    edit.step = step;
+    emit edited(edit);
+}
+
+/* Signals the rows, sorted, by runs of consecutive rows: */
+void ProofModel::stepsChanged(const QList<int> &rows)
+{
+    for (int i = 0; i < rows.size();) {
+        int first = rows[i];
+        int last = first;
+        while ((++i < rows.size()) && (rows[i] == last + 1))
+            ++last;
+        emit dataChanged(index(first, 0), index(last, ColumnCount - 1));
+    }
+}
+
+int ProofModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !proof)
+        return 0;
+    return proof->getStepCount();
+}
+
+int ProofModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProofModel::data(const QModelIndex &index, int role) const
+{
+    if (!proof || !index.isValid() || (index.row() >= proof->getStepCount()))
+        return QVariant();
+    const Step &step = proof->getStep(index.row());
+    bool invalid = (verdicts.value(index.row(), UnknownVerdict) == InvalidVerdict);
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case FormulaColumn:
+            return step.output ? step.output->getStr() : QString();
+        case RuleColumn:
+            return step.rule;
+        case InputsColumn:
+        {
+            /* Numbered from 1, as the rows: */
+            QStringList inputs;
+            foreach (int input, step.usedInputs)
+                inputs.append((input < 0) ? QString("?") : QString::number(input + 1));
+            return inputs.join(", ");
+        }
+        }
+        break;
+    case IndentationRole:
+        return step.indentation;
+    case Qt::ToolTipRole:
+        if (invalid)
+            return errors.value(index.row());
+        break;
+    case Qt::BackgroundRole:
+        if (invalid)
+            return QBrush(INVALID_STEP_COLOR);
+        break;
+    }
+    return QVariant();
+}
+
+QVariant ProofModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole)
+        return QVariant();
+    if (orientation == Qt::Vertical)
+        return section + 1;
+    switch (section) {
+    case FormulaColumn:
+        return tr("Formula");
+    case RuleColumn:
+        return tr("Rule");
+    case InputsColumn:
+        return tr("Inputs");
+    }
+    return QVariant();
+}
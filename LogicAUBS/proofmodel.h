@@ -0,0 +1,55 @@
+#ifndef PROOFMODEL_H
+#define PROOFMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QVector>
+
+#include "proof.h"
+
+/*
+ * Steps of a proof as the rows of a table, with their verdicts. Rows are only
+ * read when a view asks for them, so that a view with fixed row heights lays
+ * out the visible ones alone. The proof of the model is never verified, so that
+ * editions do not block the GUI thread: each is signalled, to be replayed on a
+ * verified copy, whose verdicts are then taken through setVerdicts(). The rows
+ * an edition touches have no verdict until then.
+ */
+class ProofModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column { FormulaColumn, RuleColumn, InputsColumn, ColumnCount };
+    /* Indentation of the step, for the formula column: */
+    enum { IndentationRole = Qt::UserRole };
+public:
+    explicit ProofModel(QObject *parent = 0);
+    ~ProofModel();
+    /* Shows the proof, which the model then owns, with its verdicts if it is verified: */
+    void setProof(Proof *newProof);
+    const Proof *getProof() const;
+    /* Takes the verdicts of a verified copy of the proof, with the same steps: */
+    void setVerdicts(const Proof &verified);
+    bool insertStep(int row, const Step &step);
+    bool removeStep(int row);
+    bool replaceStep(int row, const Step &step);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+signals:
+    /* Emitted after each edition, once the rows are updated: */
+    void edited(const ProofEdit &edit);
+private:
+    enum Verdict { UnknownVerdict, ValidVerdict, InvalidVerdict };
+private:
+    bool isEditable(int row, bool inserting) const;
+    void stepsChanged(const QList<int> &rows);
+    void stepEdited(ProofEdit::Kind kind, int row, const Step &step);
+private:
+    Proof *proof;
+    QVector<char> verdicts;
+    QVector<QString> errors;
+};
+
+#endif // PROOFMODEL_H
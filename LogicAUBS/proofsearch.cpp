@@ -0,0 +1,510 @@
+#include "proofsearch.h"
+#include "validity.h"
+
+#include <QSet>
+#include <QtAlgorithms>
+
+/* Formula sizes are only compared, so larger trees are not counted to the end: */
+#define SEARCH_SIZE_CAP 4096
+/* Conflicts allowed to the solver when checking that a subgoal may follow: */
+#define PLAUSIBLE_CONFLICTS 2000
+/* Forward lemma applications considered per available step and lemma: */
+#define LEMMA_MATCH_LIMIT 64
+
+typedef QMap<QString, const Expression *> Renaming;
+
+static int formulaSize(const Expression *e)
+{
+    int size = 0;
+    QVector<const Expression *> stack;
+    stack.append(e);
+    while (!stack.isEmpty() && (size < SEARCH_SIZE_CAP)) {
+        const Expression *top = stack.takeLast();
+        ++size;
+        for (int i = 0; i < top->getChildCount(); ++i)
+            stack.append(top->getChild(i));
+    }
+    return size;
+}
+
+static QMap<QString, const Expression *> renamingXY(const Expression *x, const Expression *y = NULL)
+{
+    QMap<QString, const Expression *> renaming;
+    renaming.insert("X", x);
+    if (y)
+        renaming.insert("Y", y);
+    return renaming;
+}
+
+ProofSearch::ProofSearch(QSharedPointer<Rule> goal)
+    : goal(goal), depth(0), maxSize(0), timeLimit(0), nodeLimit(0), depthLimit(32), expanded(0), exhausted(false) {}
+
+void ProofSearch::addLemma(const QString &name, QSharedPointer<Rule> rule)
+{
+    lemmas.insert(name, rule);
+    /* Forward, the conclusions of the lemma must not depend on anything but the matched premises: */
+    if (!rule->getPremises().isEmpty() && rule->getInputVariableSet().contains(rule->getOutputVariableSet()))
+        forwardLemmas.insert(name);
+    else
+        forwardLemmas.remove(name);
+}
+
+void ProofSearch::setTimeLimit(int milliseconds)
+{
+    timeLimit = milliseconds;
+}
+
+void ProofSearch::setNodeLimit(int nodes)
+{
+    nodeLimit = nodes;
+}
+
+void ProofSearch::setDepthLimit(int depth)
+{
+    depthLimit = depth;
+}
+
+const QList<Step> &ProofSearch::getSteps() const
+{
+    return steps;
+}
+
+const QList<int> &ProofSearch::getStepIndexes() const
+{
+    return stepIndexes;
+}
+
+QMap<QString, bool> ProofSearch::getCounterexample() const
+{
+    return counterexample;
+}
+
+int ProofSearch::getExpandedNodes() const
+{
+    return expanded;
+}
+
+ProofSearch::Result ProofSearch::run()
+{
+    timer.start();
+    steps.clear();
+    stepIndexes.clear();
+    openers.clear();
+    facts.clear();
+    factLog.clear();
+    agenda.clear();
+    path.clear();
+    counterexample.clear();
+    depth = 0;
+    expanded = 0;
+    exhausted = false;
+    QList<const Expression *> premises = goal->getPremises(), conclusions = goal->getConclusions();
+    if (conclusions.isEmpty())
+        return NotFound;
+    if (Validity::isSound(*goal, NULL, &counterexample) == Validity::Fails)
+        return NotValid;
+    maxSize = 0;
+    foreach (const Expression *premise, premises) {
+        addStep("-", QList<int>(), QMap<QString, const Expression *>(), 0, premise);
+        maxSize = qMax(maxSize, formulaSize(premise));
+    }
+    foreach (const Expression *conclusion, conclusions)
+        maxSize = qMax(maxSize, formulaSize(conclusion));
+    hypotheses = premises;
+    plausible.clear();
+    plausible.append(QHash<const Expression *, bool>());
+    saturate();
+    foreach (const Expression *conclusion, conclusions) {
+        int index = prove(conclusion, 0);
+        if (index < 0)
+            return exhausted ? OutOfBudget : NotFound;
+        stepIndexes.append(index);
+    }
+    prune();
+    return Found;
+}
+
+bool ProofSearch::isCheaper(const Candidate &a, const Candidate &b)
+{
+    return a.cost < b.cost;
+}
+
+int ProofSearch::addStep(const QString &rule, const QList<int> &inputs, const QMap<QString, const Expression *> &renaming,
+                         int clIndex, const Expression *output)
+{
+    Step step;
+    step.rule = rule;
+    step.basicRule = Proof::getBasicRule(rule);
+    step.usedInputs = inputs;
+    step.renaming = renaming;
+    step.clIndex = clIndex;
+    step.output = output;
+    step.indentation = depth;
+    int index = steps.size();
+    steps.append(step);
+    openers.append(-1);
+    if (!facts.contains(output)) {
+        facts.insert(output, index);
+        factLog.append(qMakePair(output, index));
+        agenda.insert(qMakePair(formulaSize(output), index), output);
+    }
+    return index;
+}
+
+/* Makes the formulas of the steps from the given one unavailable, as when their scope is closed: */
+void ProofSearch::forget(int fromStep)
+{
+    while (!factLog.isEmpty() && (factLog.last().second >= fromStep)) {
+        facts.remove(factLog.last().first);
+        factLog.removeLast();
+    }
+}
+
+void ProofSearch::truncate(int size)
+{
+    forget(size);
+    while (steps.size() > size)
+        steps.removeLast();
+    openers.resize(size);
+}
+
+bool ProofSearch::outOfBudget()
+{
+    if (!exhausted && (((nodeLimit > 0) && (expanded > nodeLimit)) || ((timeLimit > 0) && (timer.elapsed() > timeLimit))))
+        exhausted = true;
+    return exhausted;
+}
+
+/* Whether the goal follows from the premises and the open assumptions: */
+bool ProofSearch::isPlausible(const Expression *goal)
+{
+    QHash<const Expression *, bool> &known = plausible.last();
+    if (!known.contains(goal)) {
+        Rule rule(hypotheses, QList<const Expression *>() << goal);
+        known.insert(goal, Validity::isSound(rule, NULL, NULL, PLAUSIBLE_CONFLICTS) != Validity::Fails);
+    }
+    return known.value(goal);
+}
+
+void ProofSearch::saturate()
+{
+    while (!agenda.isEmpty() && !outOfBudget()) {
+        QMap<QPair<int, int>, const Expression *>::iterator first = agenda.begin();
+        int step = first.key().second;
+        const Expression *e = first.value();
+        agenda.erase(first);
+        if ((step < steps.size()) && (steps[step].output == e) && (facts.value(e, -1) == step)) {
+            ++expanded;
+            deriveFrom(step);
+        }
+    }
+}
+
+/* Applies the elimination rules and the forward lemmas to a step and the formulas available before it: */
+void ProofSearch::deriveFrom(int step)
+{
+    const Expression *e = steps[step].output;
+    QList<Candidate> derived;
+    Candidate c;
+    c.cost = 0;
+    const Expression *a = e->getChild(0), *b = e->getChild(1);
+    switch (e->getKind()) {
+    case Expression::AND:
+        c.rule = ":ElimAnd";
+        c.renaming = renamingXY(a, b);
+        c.inputs = QList<const Expression *>() << e;
+        c.clIndex = 0;
+        c.output = a;
+        derived.append(c);
+        c.clIndex = 1;
+        c.output = b;
+        derived.append(c);
+        break;
+    case Expression::Equiv:
+        c.rule = ":ElimEquiv";
+        c.renaming = renamingXY(a, b);
+        c.inputs = QList<const Expression *>() << e;
+        c.clIndex = 0;
+        c.output = ExprFactory::makeImply(a, b);
+        derived.append(c);
+        c.clIndex = 1;
+        c.output = ExprFactory::makeImply(b, a);
+        derived.append(c);
+        break;
+    default:
+        break;
+    }
+    /* Rules with two premises, the step being either of them: */
+    QHash<const Expression *, int>::const_iterator it;
+    for (it = facts.constBegin(); it != facts.constEnd(); ++it) {
+        const Expression *major = NULL, *minor = NULL;
+        if ((it.key()->getKind() == Expression::Imply) && (it.key()->getChild(0) == e)) {
+            major = it.key();
+            minor = e;
+        } else if ((e->getKind() == Expression::Imply) && (a == it.key())) {
+            major = e;
+            minor = it.key();
+        }
+        if (major) {
+            c.rule = ":ElimArrow";
+            c.renaming = renamingXY(minor, major->getChild(1));
+            c.inputs = QList<const Expression *>() << minor << major;
+            c.clIndex = 0;
+            c.output = major->getChild(1);
+            derived.append(c);
+        }
+        const Expression *disjunction = NULL, *negation = NULL;
+        if ((it.key()->getKind() == Expression::OR) && (e->getKind() == Expression::NOT)) {
+            disjunction = it.key();
+            negation = e;
+        } else if ((e->getKind() == Expression::OR) && (it.key()->getKind() == Expression::NOT)) {
+            disjunction = e;
+            negation = it.key();
+        }
+        if (disjunction) {
+            const Expression *left = disjunction->getChild(0), *right = disjunction->getChild(1);
+            c.renaming = renamingXY(left, right);
+            c.inputs = QList<const Expression *>() << disjunction << negation;
+            c.clIndex = 0;
+            if (negation->getChild(0) == left) {
+                c.rule = ":ElimOr1";
+                c.output = right;
+                derived.append(c);
+            }
+            if (negation->getChild(0) == right) {
+                c.rule = ":ElimOr2";
+                c.output = left;
+                derived.append(c);
+            }
+        }
+    }
+    foreach (const RuleIndex::Match &lemma, lemmas.lookup(e, RuleIndex::Premise)) {
+        if (!forwardLemmas.contains(lemma.name))
+            continue;
+        QList<const Expression *> premises = lemma.rule->getPremises();
+        QList<Renaming> matches;
+        matches.append(lemma.renaming);
+        /* The other premises are matched against the available formulas, one at a time: */
+        for (int q = 0; q < premises.size(); ++q) {
+            if (q == lemma.index)
+                continue;
+            QList<Renaming> extended;
+            foreach (const Renaming &partial, matches) {
+                for (it = facts.constBegin(); (it != facts.constEnd()) && (extended.size() < LEMMA_MATCH_LIMIT); ++it) {
+                    Renaming attempt = partial;
+                    if (RuleIndex::match(premises[q], it.key(), attempt))
+                        extended.append(attempt);
+                }
+            }
+            matches = extended;
+        }
+        foreach (const Renaming &complete, matches) {
+            Substitution substitution(complete);
+            QList<const Expression *> inputs;
+            foreach (const Expression *premise, premises)
+                inputs.append(substitution.apply(premise));
+            QList<const Expression *> conclusions = lemma.rule->getConclusions();
+            for (int k = 0; k < conclusions.size(); ++k) {
+                const Expression *output = substitution.apply(conclusions[k]);
+                if (formulaSize(output) > maxSize)
+                    continue;
+                c.rule = lemma.name;
+                c.renaming = complete;
+                c.inputs = inputs;
+                c.clIndex = k;
+                c.output = output;
+                derived.append(c);
+            }
+        }
+    }
+    foreach (const Candidate &d, derived) {
+        if (facts.contains(d.output))
+            continue;
+        QList<int> inputs;
+        foreach (const Expression *input, d.inputs)
+            inputs.append(facts.value(input));
+        addStep(d.rule, inputs, d.renaming, d.clIndex, d.output);
+    }
+}
+
+int ProofSearch::prove(const Expression *goal, int level)
+{
+    int known = facts.value(goal, -1);
+    if (known >= 0)
+        return known;
+    if ((level > depthLimit) || outOfBudget() || path.contains(goal) || !isPlausible(goal))
+        return -1;
+    ++expanded;
+    path.append(goal);
+    int result = -1;
+    if (goal->getKind() == Expression::Imply)
+        result = proveImplication(goal, level);
+    if ((result < 0) && !exhausted) {
+        QList<Candidate> list = candidates(goal);
+        foreach (const Candidate &candidate, list) {
+            if (((result = proveCandidate(candidate, goal, level)) >= 0) || exhausted)
+                break;
+        }
+    }
+    path.removeLast();
+    return result;
+}
+
+/* Assumes the left side in a new scope, and closes it once the right side is proved: */
+int ProofSearch::proveImplication(const Expression *goal, int level)
+{
+    /* What is pending belongs to the current scope, and must not be derived inside the new one only: */
+    saturate();
+    int mark = steps.size();
+    const Expression *left = goal->getChild(0), *right = goal->getChild(1);
+    ++depth;
+    int opener = addStep(":Assume", QList<int>(), renamingXY(left), 0, left);
+    hypotheses.append(left);
+    plausible.append(QHash<const Expression *, bool>());
+    saturate();
+    int proved = prove(right, level + 1);
+    hypotheses.removeLast();
+    plausible.removeLast();
+    --depth;
+    if (proved < 0) {
+        truncate(mark);
+        return -1;
+    }
+    forget(opener);
+    int result = addStep(":IntroArrow", QList<int>() << proved, renamingXY(left, right), 0, goal);
+    openers[result] = opener;
+    return result;
+}
+
+int ProofSearch::proveCandidate(const Candidate &candidate, const Expression *goal, int level)
+{
+    int mark = steps.size();
+    QList<int> inputs;
+    foreach (const Expression *input, candidate.inputs) {
+        int index = prove(input, level + 1);
+        if (index < 0) {
+            truncate(mark);
+            return -1;
+        }
+        inputs.append(index);
+    }
+    return addStep(candidate.rule, inputs, candidate.renaming, candidate.clIndex, goal);
+}
+
+/* Ways to conclude the goal in one step, those needing the least new formulas first: */
+QList<ProofSearch::Candidate> ProofSearch::candidates(const Expression *goal)
+{
+    QList<Candidate> result;
+    Candidate c;
+    c.clIndex = 0;
+    const Expression *a = goal->getChild(0), *b = goal->getChild(1);
+    switch (goal->getKind()) {
+    case Expression::AND:
+        c.rule = ":IntroAnd";
+        c.renaming = renamingXY(a, b);
+        c.inputs = QList<const Expression *>() << a << b;
+        result.append(c);
+        break;
+    case Expression::OR:
+        c.rule = ":IntroOr";
+        c.renaming = renamingXY(a, b);
+        c.inputs = QList<const Expression *>() << a;
+        result.append(c);
+        c.renaming = renamingXY(b, a);
+        c.inputs = QList<const Expression *>() << b;
+        c.clIndex = 1;
+        result.append(c);
+        c.clIndex = 0;
+        break;
+    case Expression::Equiv:
+        c.rule = ":IntroEquiv";
+        c.renaming = renamingXY(a, b);
+        c.inputs = QList<const Expression *>() << ExprFactory::makeImply(a, b) << ExprFactory::makeImply(b, a);
+        result.append(c);
+        break;
+    default:
+        break;
+    }
+    QHash<const Expression *, int>::const_iterator it;
+    for (it = facts.constBegin(); it != facts.constEnd(); ++it) {
+        const Expression *f = it.key();
+        if ((f->getKind() == Expression::Imply) && (f->getChild(1) == goal)) {
+            c.rule = ":ElimArrow";
+            c.renaming = renamingXY(f->getChild(0), goal);
+            c.inputs = QList<const Expression *>() << f->getChild(0) << f;
+            result.append(c);
+        } else if (f->getKind() == Expression::OR) {
+            if (f->getChild(1) == goal) {
+                c.rule = ":ElimOr1";
+                c.renaming = renamingXY(f->getChild(0), goal);
+                c.inputs = QList<const Expression *>() << f << ExprFactory::makeNOT(f->getChild(0));
+                result.append(c);
+            }
+            if (f->getChild(0) == goal) {
+                c.rule = ":ElimOr2";
+                c.renaming = renamingXY(goal, f->getChild(1));
+                c.inputs = QList<const Expression *>() << f << ExprFactory::makeNOT(f->getChild(1));
+                result.append(c);
+            }
+        }
+    }
+    foreach (const RuleIndex::Match &lemma, lemmas.lookup(goal, RuleIndex::Conclusion)) {
+        /* The premises must not have variables of their own, left unbound by the conclusion: */
+        if (!lemma.rule->getConclusions()[lemma.index]->getVariableSet().contains(lemma.rule->getInputVariableSet()))
+            continue;
+        c.rule = lemma.name;
+        c.renaming = lemma.renaming;
+        c.inputs.clear();
+        Substitution substitution(lemma.renaming);
+        foreach (const Expression *premise, lemma.rule->getPremises())
+            c.inputs.append(substitution.apply(premise));
+        c.clIndex = lemma.index;
+        result.append(c);
+    }
+    for (int i = 0; i < result.size(); ++i) {
+        result[i].cost = 1;
+        foreach (const Expression *input, result[i].inputs) {
+            if (!facts.contains(input))
+                result[i].cost += formulaSize(input);
+        }
+    }
+    qStableSort(result.begin(), result.end(), isCheaper);
+    return result;
+}
+
+/* Keeps the steps the conclusions depend on, with the assumptions of the scopes they close: */
+void ProofSearch::prune()
+{
+    int premiseCount = goal->getPremises().size();
+    QVector<bool> needed(steps.size());
+    for (int i = 0; i < premiseCount; ++i)
+        needed[i] = true;
+    QVector<int> stack = stepIndexes.toVector();
+    while (!stack.isEmpty()) {
+        int i = stack.takeLast();
+        if (needed[i])
+            continue;
+        needed[i] = true;
+        foreach (int input, steps[i].usedInputs)
+            stack.append(input);
+        if (openers[i] >= 0)
+            stack.append(openers[i]);
+    }
+    QVector<int> newIndexes(steps.size(), -1);
+    QList<Step> kept;
+    QVector<int> keptOpeners;
+    for (int i = 0; i < steps.size(); ++i) {
+        if (!needed[i])
+            continue;
+        newIndexes[i] = kept.size();
+        Step step = steps[i];
+        for (int j = 0; j < step.usedInputs.size(); ++j)
+            step.usedInputs[j] = newIndexes[step.usedInputs[j]];
+        kept.append(step);
+        keptOpeners.append((openers[i] < 0) ? -1 : newIndexes[openers[i]]);
+    }
+    for (int i = 0; i < stepIndexes.size(); ++i)
+        stepIndexes[i] = newIndexes[stepIndexes[i]];
+    steps = kept;
+    openers = keptOpeners;
+}
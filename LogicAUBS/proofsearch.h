@@ -0,0 +1,89 @@
+#ifndef PROOFSEARCH_H
+#define PROOFSEARCH_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+
+#include "proof.h"
+#include "ruleindex.h"
+
+/*
+ * Automated proof search. The elimination rules (and the lemmas whose
+ * conclusions are determined by their premises) are applied forward, best
+ * first, to the formulas available in the current scope; a formula that is
+ * available already is never derived again. Goals that are not available are
+ * then split backward through the introduction rules, :ElimArrow, :ElimOr1,
+ * :ElimOr2 and the lemmas, cheapest first, and an implication is proved by
+ * assuming its left side in a new scope. Subgoals that do not follow
+ * semantically from the premises and the open assumptions are not explored.
+ * :RAA is never used: it concludes its own assumption, so that a proof using
+ * it does not show that the goal is valid.
+ */
+class ProofSearch
+{
+public:
+    enum Result { Found, NotValid, OutOfBudget, NotFound };
+public:
+    ProofSearch(QSharedPointer<Rule> goal);
+    void addLemma(const QString &name, QSharedPointer<Rule> rule);
+    void setTimeLimit(int milliseconds);
+    void setNodeLimit(int nodes);
+    void setDepthLimit(int depth);
+    Result run();
+    const QList<Step> &getSteps() const;
+    const QList<int> &getStepIndexes() const;
+    QMap<QString, bool> getCounterexample() const;
+    int getExpandedNodes() const;
+private:
+    struct Candidate
+    {
+        QString rule;
+        QMap<QString, const Expression *> renaming;
+        QList<const Expression *> inputs;
+        int clIndex, cost;
+        const Expression *output;
+    };
+private:
+    int addStep(const QString &rule, const QList<int> &inputs, const QMap<QString, const Expression *> &renaming,
+                int clIndex, const Expression *output);
+    void forget(int fromStep);
+    void truncate(int size);
+    bool outOfBudget();
+    bool isPlausible(const Expression *goal);
+    void saturate();
+    void deriveFrom(int step);
+    int prove(const Expression *goal, int level);
+    int proveImplication(const Expression *goal, int level);
+    int proveCandidate(const Candidate &candidate, const Expression *goal, int level);
+    QList<Candidate> candidates(const Expression *goal);
+    void prune();
+    static bool isCheaper(const Candidate &a, const Candidate &b);
+private:
+    QSharedPointer<Rule> goal;
+    RuleIndex lemmas;
+    QSet<QString> forwardLemmas;
+    QList<Step> steps;
+    QList<int> stepIndexes;
+    QVector<int> openers;
+    /* Formulas available in the current scope and the step holding them, in the order they became available: */
+    QHash<const Expression *, int> facts;
+    QVector<QPair<const Expression *, int> > factLog;
+    /* Available steps not yet used for forward derivations, smallest formula first: */
+    QMap<QPair<int, int>, const Expression *> agenda;
+    QList<const Expression *> hypotheses;
+    QList< QHash<const Expression *, bool> > plausible;
+    QList<const Expression *> path;
+    int depth, maxSize;
+    int timeLimit, nodeLimit, depthLimit, expanded;
+    bool exhausted;
+    QElapsedTimer timer;
+    QMap<QString, bool> counterexample;
+};
+
+#endif // PROOFSEARCH_H
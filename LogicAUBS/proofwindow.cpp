@@ -2,22 +2,81 @@
 
 #include <QMessageBox>
 #include <QCloseEvent>
+#include <QHeaderView>
+#include <QStyledItemDelegate>
+#include <QPainter>
 
-ProofWindow::ProofWindow(QWidget *parent, QString filename) : QMdiSubWindow(parent), filename(filename), modified(false)
+/* Time without edits before a proof is verified again, in milliseconds: */
+#define VERIFICATION_DELAY 300
+
+/* Width of an indentation level of the formulas, in average characters: */
+#define INDENTATION_CHARS 4
+
+/* Shifts the formulas right by their indentation, and draws a bar per level: */
+class IndentationDelegate : public QStyledItemDelegate
+{
+public:
+    IndentationDelegate(QObject *parent) : QStyledItemDelegate(parent) {}
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+    {
+        int indentation = qMax(0, index.data(ProofModel::IndentationRole).toInt());
+        int width = INDENTATION_CHARS * option.fontMetrics.averageCharWidth();
+        QStyleOptionViewItem shifted(option);
+        shifted.rect.setLeft(option.rect.left() + indentation * width);
+        QStyledItemDelegate::paint(painter, shifted, index);
+        painter->save();
+        painter->setPen(option.palette.color(QPalette::Mid));
+        for (int i = 0; i < indentation; ++i) {
+            int x = option.rect.left() + i * width + width / 2;
+            painter->drawLine(x, option.rect.top(), x, option.rect.bottom());
+        }
+        painter->restore();
+    }
+};
+
+ProofWindow::ProofWindow(VerificationPool *pool, QWidget *parent, QString filename)
+    : QMdiSubWindow(parent), pool(pool), job(-1), verified(NULL), filename(filename), modified(false)
 {
     setAttribute(Qt::WA_DeleteOnClose);
     if (filename.isEmpty()) {
-        setWindowTitle("[New Proof]");
+        dispname = "[New Proof]";
+        setWindowTitle(dispname);
     } else {
         filename.replace('\\', '/');
         dispname = filename.mid(filename.lastIndexOf('/') + 1);
         setWindowTitle(dispname);
     }
-    view = new QWebView(this);
-    view->setUrl(QUrl("qrc:/res/page.html"));
+    model = new ProofModel(this);
+    connect(model, SIGNAL(edited(ProofEdit)), this, SLOT(scheduleVerification(ProofEdit)));
+    verificationTimer.setSingleShot(true);
+    verificationTimer.setInterval(VERIFICATION_DELAY);
+    connect(&verificationTimer, SIGNAL(timeout()), this, SLOT(startVerification()));
+    connect(pool, SIGNAL(progress(int,int,int)), this, SLOT(verificationProgress(int,int,int)));
+    connect(pool, SIGNAL(finished(int)), this, SLOT(verificationFinished(int)));
+    /* The proof is loaded along with its verification: */
+    if (!filename.isEmpty())
+        job = pool->open(filename);
+    view = new QTableView(this);
+    view->setModel(model);
+    view->setItemDelegateForColumn(ProofModel::FormulaColumn, new IndentationDelegate(view));
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setWordWrap(false);
+    /* Fixed row heights and column widths, so that only the visible rows are measured and drawn: */
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(view->fontMetrics().height() + 4);
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    view->horizontalHeader()->setStretchLastSection(true);
+    view->setColumnWidth(ProofModel::FormulaColumn, 40 * view->fontMetrics().averageCharWidth());
+    view->setColumnWidth(ProofModel::RuleColumn, 16 * view->fontMetrics().averageCharWidth());
     setWidget(view);
 }
 
+ProofWindow::~ProofWindow()
+{
+    cancelVerification();
+    delete verified;
+}
+
 bool ProofWindow::prepareClose() const
 {
     if (!modified)
@@ -48,6 +107,64 @@ void ProofWindow::closeEvent(QCloseEvent *closeEvent)
         closeEvent->ignore();
         return;
     }
+    cancelVerification();
     emit closed();
     closeEvent->accept();
 }
+
+void ProofWindow::cancelVerification()
+{
+    verificationTimer.stop();
+    if (job >= 0) {
+        pool->cancel(job);
+        job = -1;
+        setWindowTitle(dispname);
+    }
+}
+
+void ProofWindow::verificationProgress(int job, int checked, int total)
+{
+    if ((job != this->job) || !total)
+        return;
+    setWindowTitle(tr("%1 (verifying, %2%)").arg(dispname).arg((qint64) checked * 100 / total));
+}
+
+void ProofWindow::verificationFinished(int job)
+{
+    if (job != this->job)
+        return;
+    this->job = -1;
+    setWindowTitle(dispname);
+    verified = pool->takeResult(job);
+    if (!verified)
+        return;
+    if (!model->getProof()) {
+        if (verified->getRule().isNull())
+            QMessageBox::warning(this, tr("Could not open the proof"), verified->getLastError());
+        /* The copy shares the steps with the verified proof until either is edited: */
+        model->setProof(new Proof(*verified));
+        return;
+    }
+    /* The verdicts only match the rows once the verified proof caught up with the model: */
+    if (pendingEdits.isEmpty())
+        model->setVerdicts(*verified);
+    else if (!verificationTimer.isActive())
+        startVerification();
+}
+
+void ProofWindow::scheduleVerification(const ProofEdit &edit)
+{
+    modified = true;
+    pendingEdits.append(edit);
+    verificationTimer.start();
+}
+
+/* Waits for the running job, if any, which hands the verified proof back: */
+void ProofWindow::startVerification()
+{
+    if ((job >= 0) || !verified || pendingEdits.isEmpty())
+        return;
+    job = pool->edit(verified, pendingEdits);
+    verified = NULL;
+    pendingEdits.clear();
+}
@@ -1,14 +1,19 @@
-#ifndef PROOF_H
-#define PROOF_H
+#ifndef PROOFWINDOW_H
+#define PROOFWINDOW_H
 
 #include <QMdiSubWindow>
-#include <QWebView>
+#include <QTableView>
+#include <QTimer>
+
+#include "proofmodel.h"
+#include "verificationpool.h"
 
 class ProofWindow : public QMdiSubWindow
 {
     Q_OBJECT
 public:
-    explicit ProofWindow(QWidget *parent = 0, QString filename = QString());
+    explicit ProofWindow(VerificationPool *pool, QWidget *parent = 0, QString filename = QString());
+    ~ProofWindow();
     bool prepareClose() const;
     bool save() const;
 signals:
@@ -16,10 +21,27 @@ signals:
 public slots:
 protected:
     void closeEvent(QCloseEvent *closeEvent);
+private slots:
+    void verificationProgress(int job, int checked, int total);
+    void verificationFinished(int job);
+    void scheduleVerification(const ProofEdit &edit);
+    void startVerification();
+private:
+    void cancelVerification();
 private:
-    QWebView *view;
+    VerificationPool *pool;
+    /* Running job of the pool for this window, or -1: */
+    int job;
+    /* Verified copy of the proof of the model, owned by the pool while a job edits it: */
+    Proof *verified;
+    /* Edits of the model not passed to the verified copy yet: */
+    QList<ProofEdit> pendingEdits;
+    /* Started once the edits stop, so that a burst of edits is passed at once: */
+    QTimer verificationTimer;
+    QTableView *view;
+    ProofModel *model;
     QString filename, dispname;
     mutable bool modified;
 };
 
-#endif // PROOF_H
+#endif // PROOFWINDOW_H
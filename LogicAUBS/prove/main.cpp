@@ -0,0 +1,94 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QDir>
+
+#include <cstdio>
+
+#include "proof.h"
+#include "lemmacache.h"
+#include "proofsearch.h"
+
+/* Exit codes: */
+#define EXIT_PROVED 0
+#define EXIT_FAILED 1
+#define EXIT_USAGE 2
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aubs-prove");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Searches for a proof of a rule, and writes it to a proof file.");
+    parser.addHelpOption();
+    QCommandLineOption lemmaOption("lemma", "Proof file of a lemma the search may use (repeatable).", "file");
+    QCommandLineOption timeOption("time", "Time limit in milliseconds (0 for none).", "ms", "10000");
+    QCommandLineOption nodesOption("nodes", "Limit on the expanded search nodes (0 for none).", "n", "0");
+    QCommandLineOption depthOption("depth", "Maximum nesting of subgoals.", "n", "32");
+    parser.addOption(lemmaOption);
+    parser.addOption(timeOption);
+    parser.addOption(nodesOption);
+    parser.addOption(depthOption);
+    parser.addPositionalArgument("rule", "Rule to prove, such as \"X>Y, Y>Z : X>Z\".");
+    parser.addPositionalArgument("output", "Proof file to write.");
+    parser.process(app);
+    QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2) {
+        fprintf(stderr, "%s", parser.helpText().toLocal8Bit().constData());
+        return EXIT_USAGE;
+    }
+    QString error;
+    QSharedPointer<Rule> rule(Rule::fromStr(arguments[0], &error));
+    if (rule.isNull()) {
+        fprintf(stderr, "Invalid rule: %s\n", error.toLocal8Bit().constData());
+        return EXIT_USAGE;
+    }
+    ProofSearch search(rule);
+    search.setTimeLimit(parser.value(timeOption).toInt());
+    search.setNodeLimit(parser.value(nodesOption).toInt());
+    search.setDepthLimit(parser.value(depthOption).toInt());
+
+    /* Lemmas are referred to relatively to the proof being written, as when entered by hand: */
+    QDir outputDir = QFileInfo(arguments[1]).absoluteDir();
+    foreach (const QString &file, parser.values(lemmaOption)) {
+        LemmaCache::Lemma lemma = LemmaCache::get(QFileInfo(file).absoluteFilePath());
+        if (lemma.status != LemmaCache::Verified) {
+            fprintf(stderr, "%s: %s\n", file.toLocal8Bit().constData(), lemma.error.toLocal8Bit().constData());
+            return EXIT_FAILED;
+        }
+        search.addLemma(outputDir.relativeFilePath(QFileInfo(file).absoluteFilePath()), lemma.rule);
+    }
+
+    switch (search.run()) {
+    case ProofSearch::Found:
+        break;
+    case ProofSearch::NotValid:
+    {
+        fprintf(stderr, "The rule is not valid; counterexample:");
+        QMap<QString, bool> counterexample = search.getCounterexample();
+        QMap<QString, bool>::const_iterator it;
+        for (it = counterexample.constBegin(); it != counterexample.constEnd(); ++it)
+            fprintf(stderr, " %s=%d", it.key().toLocal8Bit().constData(), int(it.value()));
+        fprintf(stderr, "\n");
+        return EXIT_FAILED;
+    }
+    case ProofSearch::OutOfBudget:
+        fprintf(stderr, "No proof found within the limits (%d nodes expanded).\n", search.getExpandedNodes());
+        return EXIT_FAILED;
+    case ProofSearch::NotFound:
+        fprintf(stderr, "No proof found with the available rules and lemmas.\n");
+        return EXIT_FAILED;
+    }
+    Proof proof(rule, search.getSteps(), search.getStepIndexes());
+    /* The search is not trusted; only a proof that verifies is written: */
+    if (!proof.isCorrect() || !proof.isFinished()) {
+        fprintf(stderr, "The proof found does not verify: %s\n", proof.getLastError().toLocal8Bit().constData());
+        return EXIT_FAILED;
+    }
+    if (!proof.saveToFile(arguments[1])) {
+        fprintf(stderr, "%s: %s\n", arguments[1].toLocal8Bit().constData(), proof.getLastError().toLocal8Bit().constData());
+        return EXIT_FAILED;
+    }
+    printf("%d steps, %d nodes expanded\n", search.getSteps().size(), search.getExpandedNodes());
+    return EXIT_PROVED;
+}
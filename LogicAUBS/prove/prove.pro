@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Automated proof search
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = aubs-prove
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,217 @@
+#include "ruleindex.h"
+
+#include <QtAlgorithms>
+
+/* Edges of a node, among which the wildcard: */
+#define SYMBOL_COUNT (Expression::Equiv + 1)
+
+RuleIndex::RuleIndex()
+{
+    clear();
+}
+
+void RuleIndex::clear()
+{
+    nodes.clear();
+    entries.clear();
+    byName.clear();
+    freeNodes.clear();
+    freeEntries.clear();
+    nextOrder = 0;
+    Node root;
+    for (int s = 0; s < SYMBOL_COUNT; ++s)
+        root.next[s] = -1;
+    root.parent = root.symbol = -1;
+    nodes.append(root);
+    nodes.append(root);
+}
+
+int RuleIndex::child(int node, int symbol)
+{
+    if (nodes[node].next[symbol] < 0) {
+        Node fresh;
+        for (int s = 0; s < SYMBOL_COUNT; ++s)
+            fresh.next[s] = -1;
+        fresh.parent = node;
+        fresh.symbol = symbol;
+        int id;
+        if (freeNodes.isEmpty()) {
+            id = nodes.size();
+            nodes.append(fresh);
+        } else {
+            id = freeNodes.takeLast();
+            nodes[id] = fresh;
+        }
+        nodes[node].next[symbol] = id;
+    }
+    return nodes[node].next[symbol];
+}
+
+/* Frees the node and its ancestors as long as they lead to no pattern; the roots are kept: */
+void RuleIndex::prune(int node)
+{
+    while ((node > Conclusion) && nodes[node].entries.isEmpty()) {
+        for (int s = 0; s < SYMBOL_COUNT; ++s) {
+            if (nodes[node].next[s] >= 0)
+                return;
+        }
+        int parent = nodes[node].parent;
+        nodes[parent].next[nodes[node].symbol] = -1;
+        nodes[node].entries.clear();
+        freeNodes.append(node);
+        node = parent;
+    }
+}
+
+void RuleIndex::insertPattern(const Expression *pattern, int entry)
+{
+    int node = entries[entry].side;
+    /* Connectives in prefix order, the variables being wildcards: */
+    QVector<const Expression *> stack;
+    stack.append(pattern);
+    while (!stack.isEmpty()) {
+        const Expression *top = stack.takeLast();
+        node = child(node, top->getKind());
+        for (int i = top->getChildCount(); i-- > 0;)
+            stack.append(top->getChild(i));
+    }
+    nodes[node].entries.append(entry);
+    entries[entry].leaf = node;
+}
+
+/* Indexes the premises and conclusions of a rule, replacing any rule of the same name: */
+void RuleIndex::insert(const QString &name, QSharedPointer<Rule> rule)
+{
+    remove(name);
+    QVector<int> &ids = byName[name];
+    for (int side = Premise; side <= Conclusion; ++side) {
+        QList<const Expression *> formulas = (side == Premise) ? rule->getPremises() : rule->getConclusions();
+        for (int k = 0; k < formulas.size(); ++k) {
+            Entry entry;
+            entry.name = name;
+            entry.rule = rule;
+            entry.side = Side(side);
+            entry.index = k;
+            entry.leaf = -1;
+            entry.order = nextOrder++;
+            int id;
+            if (freeEntries.isEmpty()) {
+                id = entries.size();
+                entries.append(entry);
+            } else {
+                id = freeEntries.takeLast();
+                entries[id] = entry;
+            }
+            ids.append(id);
+            insertPattern(formulas[k], id);
+        }
+    }
+}
+
+void RuleIndex::insertBasicRules()
+{
+    QMap<QString, QSharedPointer<Rule> > rules = Proof::getBasicRules();
+    QMap<QString, QSharedPointer<Rule> >::const_iterator it;
+    for (it = rules.constBegin(); it != rules.constEnd(); ++it)
+        insert(it.key(), it.value());
+}
+
+bool RuleIndex::remove(const QString &name)
+{
+    if (!byName.contains(name))
+        return false;
+    foreach (int id, byName.take(name)) {
+        int leaf = entries[id].leaf;
+        nodes[leaf].entries.remove(nodes[leaf].entries.indexOf(id));
+        prune(leaf);
+        entries[id].name.clear();
+        entries[id].rule.clear();
+        entries[id].leaf = -1;
+        freeEntries.append(id);
+    }
+    return true;
+}
+
+int RuleIndex::getRuleCount() const
+{
+    return byName.size();
+}
+
+int RuleIndex::getNodeCount() const
+{
+    return nodes.size() - freeNodes.size();
+}
+
+/* The patterns of the side matching the formula, in the order they were indexed: */
+QList<RuleIndex::Match> RuleIndex::lookup(const Expression *formula, Side side) const
+{
+    QVector<QPair<qint64, int> > found;
+    QVector<Position> work;
+    Position start;
+    start.node = side;
+    start.pending.append(formula);
+    work.append(start);
+    while (!work.isEmpty()) {
+        Position state = work.takeLast();
+        if (state.pending.isEmpty()) {
+            foreach (int id, nodes[state.node].entries)
+                found.append(qMakePair(entries[id].order, id));
+            continue;
+        }
+        const Node &node = nodes[state.node];
+        const Expression *next = state.pending.takeLast();
+        Expression::Kind kind = next->getKind();
+        if ((kind != Expression::Variable) && (node.next[kind] >= 0)) {
+            Position deeper;
+            deeper.node = node.next[kind];
+            deeper.pending = state.pending;
+            for (int i = next->getChildCount(); i-- > 0;)
+                deeper.pending.append(next->getChild(i));
+            work.append(deeper);
+        }
+        if (node.next[Expression::Variable] >= 0) {
+            state.node = node.next[Expression::Variable];
+            work.append(state);
+        }
+    }
+    qSort(found);
+    QList<Match> result;
+    for (int i = 0; i < found.size(); ++i) {
+        const Entry &entry = entries[found[i].second];
+        Match m;
+        const Expression *pattern = (entry.side == Premise) ? entry.rule->getPremises()[entry.index]
+                                                            : entry.rule->getConclusions()[entry.index];
+        if (!match(pattern, formula, m.renaming))
+            continue;
+        m.name = entry.name;
+        m.rule = entry.rule;
+        m.side = entry.side;
+        m.index = entry.index;
+        result.append(m);
+    }
+    return result;
+}
+
+/* Extends the renaming so that the pattern becomes the formula, if possible: */
+bool RuleIndex::match(const Expression *pattern, const Expression *formula, QMap<QString, const Expression *> &renaming)
+{
+    QVector<QPair<const Expression *, const Expression *> > stack;
+    stack.append(qMakePair(pattern, formula));
+    while (!stack.isEmpty()) {
+        QPair<const Expression *, const Expression *> top = stack.takeLast();
+        if (top.first->getKind() == Expression::Variable) {
+            const QString &name = static_cast<const ExprVar *>(top.first)->getName();
+            const Expression *bound = renaming.value(name, NULL);
+            if (!bound)
+                renaming.insert(name, top.second);
+            else if (bound != top.second)
+                return false;
+            continue;
+        }
+        if (top.first->getKind() != top.second->getKind())
+            return false;
+        for (int i = 0; i < top.first->getChildCount(); ++i)
+            stack.append(qMakePair(top.first->getChild(i), top.second->getChild(i)));
+    }
+    return true;
+}
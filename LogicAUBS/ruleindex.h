@@ -0,0 +1,85 @@
+#ifndef RULEINDEX_H
+#define RULEINDEX_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "proof.h"
+
+/*
+ * Discrimination tree over the premises and conclusions of a set of rules.
+ * Every formula of an indexed rule is a pattern, stored along the path of its
+ * connectives in prefix order, each variable being a wildcard. A lookup follows
+ * the connectives of the given formula, and the wildcard edges skipping a whole
+ * subformula, so that only the patterns whose shape fits are visited; these are
+ * then matched, which checks the repeated variables and computes the renaming.
+ * The variables of the rules are all renamable, so that a variable of the
+ * given formula only ever matches a wildcard.
+ * Removing a rule frees its entries and the nodes left without any pattern,
+ * which later insertions reuse, so that replacing rules does not grow the tree.
+ */
+class RuleIndex
+{
+public:
+    enum Side { Premise, Conclusion };
+    struct Match
+    {
+        QString name;
+        QSharedPointer<Rule> rule;
+        Side side;
+        int index;
+        /* Renaming of the variables of the pattern, making it the looked up formula: */
+        QMap<QString, const Expression *> renaming;
+    };
+public:
+    RuleIndex();
+    void insert(const QString &name, QSharedPointer<Rule> rule);
+    void insertBasicRules();
+    bool remove(const QString &name);
+    void clear();
+    int getRuleCount() const;
+    int getNodeCount() const;
+    QList<Match> lookup(const Expression *formula, Side side) const;
+public:
+    static bool match(const Expression *pattern, const Expression *formula, QMap<QString, const Expression *> &renaming);
+private:
+    /* Edges are indexed by kind, Expression::Variable standing for the wildcard: */
+    struct Node
+    {
+        int next[Expression::Equiv + 1];
+        int parent, symbol;
+        QVector<int> entries;
+    };
+    struct Entry
+    {
+        QString name;
+        QSharedPointer<Rule> rule;
+        Side side;
+        int index, leaf;
+        /* Entries are reused, so that the order of insertion is kept apart: */
+        qint64 order;
+    };
+    /* A node reached by a lookup, with the subformulas still to be read, the next one last: */
+    struct Position
+    {
+        int node;
+        QVector<const Expression *> pending;
+    };
+private:
+    int child(int node, int symbol);
+    void insertPattern(const Expression *pattern, int entry);
+    void prune(int node);
+private:
+    /* One tree per side, rooted at nodes 0 and 1: */
+    QVector<Node> nodes;
+    QVector<Entry> entries;
+    QHash<QString, QVector<int> > byName;
+    QVector<int> freeNodes, freeEntries;
+    qint64 nextOrder;
+};
+
+#endif // RULEINDEX_H
@@ -0,0 +1,634 @@
+#include "satsolver.h"
+
+#include <QPair>
+#include <QSet>
+#include <QtAlgorithms>
+
+#include <cstdlib>
+#include <new>
+
+#define VARIABLE_DECAY 0.95
+#define CLAUSE_DECAY 0.999
+#define RESTART_BASE 100
+#define LEARNTS_GROWTH 1.1
+#define LEARNTS_ADJUST_START 100
+#define LEARNTS_ADJUST_GROWTH 1.5
+
+struct SatClause
+{
+    int size;
+    bool learnt;
+    float activity;
+    int literals[1];
+};
+
+static SatClause *newClause(const QVector<int> &literals, bool learnt)
+{
+    void *memory = ::operator new(sizeof(SatClause) + sizeof(int) * (qMax(literals.size(), 1) - 1));
+    SatClause *clause = static_cast<SatClause *>(memory);
+    clause->size = literals.size();
+    clause->learnt = learnt;
+    clause->activity = 0;
+    for (int i = 0; i < literals.size(); ++i)
+        clause->literals[i] = literals[i];
+    return clause;
+}
+
+static inline void deleteClause(SatClause *clause)
+{
+    ::operator delete(clause);
+}
+
+/* Binary clauses are always kept, the others ordered by activity: */
+static bool lessUseful(const SatClause *a, const SatClause *b)
+{
+    return (a->size > 2) && ((b->size == 2) || (a->activity < b->activity));
+}
+
+/* Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, ... (index from 0): */
+static double luby(int index)
+{
+    int size = 1, sequence = 0;
+    while (size < index + 1) {
+        ++sequence;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != index) {
+        size = (size - 1) >> 1;
+        --sequence;
+        index = index % size;
+    }
+    double result = 1;
+    while (sequence-- > 0)
+        result *= 2;
+    return result;
+}
+
+SatSolver::SatSolver() : ok(true), propagationHead(0), variableIncrement(1), clauseIncrement(1), maxLearnts(0),
+    learntsAdjustInterval(LEARNTS_ADJUST_START), learntsAdjustCountdown(LEARNTS_ADJUST_START)
+{
+    stats.decisions = stats.propagations = stats.conflicts = stats.restarts = stats.learnts = 0;
+}
+
+SatSolver::~SatSolver()
+{
+    foreach (SatClause *clause, clauses)
+        deleteClause(clause);
+    foreach (SatClause *clause, learnts)
+        deleteClause(clause);
+}
+
+int SatSolver::newVariable()
+{
+    int v = levels.size();
+    watches.append(QVector<Watcher>());
+    watches.append(QVector<Watcher>());
+    values.append(0);
+    values.append(0);
+    levels.append(0);
+    reasons.append(NULL);
+    phases.append(false);
+    activity.append(0);
+    heapIndexes.append(-1);
+    seen.append(false);
+    heapInsert(v);
+    return v;
+}
+
+int SatSolver::getVariableCount() const
+{
+    return levels.size();
+}
+
+inline int SatSolver::value(int literal) const
+{
+    return values[literal];
+}
+
+int SatSolver::decisionLevel() const
+{
+    return trailLimits.size();
+}
+
+bool SatSolver::addClause(QVector<int> literals)
+{
+    if (!ok)
+        return false;
+    backtrack(0);
+    qSort(literals);
+    int j = 0;
+    for (int i = 0; i < literals.size(); ++i) {
+        int l = literals[i];
+        if ((value(l) > 0) || ((j > 0) && (literals[j - 1] == SatSolver::negate(l))))
+            return true;
+        if ((value(l) < 0) || ((j > 0) && (literals[j - 1] == l)))
+            continue;
+        literals[j++] = l;
+    }
+    literals.resize(j);
+    if (literals.isEmpty())
+        return ok = false;
+    if (literals.size() == 1) {
+        assign(literals[0], NULL);
+        return ok = !propagate();
+    }
+    SatClause *clause = newClause(literals, false);
+    clauses.append(clause);
+    attach(clause);
+    return true;
+}
+
+void SatSolver::attach(SatClause *clause)
+{
+    Watcher w;
+    w.clause = clause;
+    w.blocker = clause->literals[1];
+    watches[clause->literals[0]].append(w);
+    w.blocker = clause->literals[0];
+    watches[clause->literals[1]].append(w);
+}
+
+void SatSolver::assign(int literal, SatClause *reason)
+{
+    int v = literal >> 1;
+    values[literal] = 1;
+    values[literal ^ 1] = -1;
+    levels[v] = decisionLevel();
+    reasons[v] = reason;
+    trail.append(literal);
+}
+
+/* Watchers of a literal are visited when it becomes false; returns the conflicting clause, if any: */
+SatClause *SatSolver::propagate()
+{
+    SatClause *conflict = NULL;
+    while (propagationHead < trail.size()) {
+        int falseLiteral = SatSolver::negate(trail[propagationHead++]);
+        QVector<Watcher> &ws = watches[falseLiteral];
+        Watcher *begin = ws.data(), *end = begin + ws.size();
+        Watcher *i = begin, *j = begin;
+        ++stats.propagations;
+        while (i != end) {
+            if (value(i->blocker) > 0) {
+                *j++ = *i++;
+                continue;
+            }
+            SatClause *clause = i->clause;
+            int *lits = clause->literals;
+            if (lits[0] == falseLiteral) {
+                lits[0] = lits[1];
+                lits[1] = falseLiteral;
+            }
+            ++i;
+            Watcher w;
+            w.clause = clause;
+            w.blocker = lits[0];
+            if ((lits[0] != i[-1].blocker) && (value(lits[0]) > 0)) {
+                *j++ = w;
+                continue;
+            }
+            bool moved = false;
+            for (int k = 2; k < clause->size; ++k) {
+                if (value(lits[k]) >= 0) {
+                    lits[1] = lits[k];
+                    lits[k] = falseLiteral;
+                    watches[lits[1]].append(w);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved)
+                continue;
+            *j++ = w;
+            if (value(lits[0]) < 0) {
+                conflict = clause;
+                propagationHead = trail.size();
+                while (i != end)
+                    *j++ = *i++;
+            } else {
+                assign(lits[0], clause);
+            }
+        }
+        ws.resize(j - begin);
+        if (conflict)
+            break;
+    }
+    return conflict;
+}
+
+void SatSolver::analyze(SatClause *conflict, QVector<int> &learnt, int &backtrackLevel)
+{
+    int pathCount = 0, p = -1, index = trail.size() - 1;
+    learnt.resize(1);
+    do {
+        if (conflict->learnt)
+            bumpClause(conflict);
+        for (int k = (p < 0) ? 0 : 1; k < conflict->size; ++k) {
+            int q = conflict->literals[k], v = q >> 1;
+            if (seen[v] || !levels[v])
+                continue;
+            bumpVariable(v);
+            seen[v] = true;
+            if (levels[v] >= decisionLevel())
+                ++pathCount;
+            else
+                learnt.append(q);
+        }
+        while (!seen[trail[index] >> 1])
+            --index;
+        p = trail[index--];
+        conflict = reasons[p >> 1];
+        seen[p >> 1] = false;
+        --pathCount;
+    } while (pathCount > 0);
+    learnt[0] = SatSolver::negate(p);
+
+    /* Drop the literals implied by the others: */
+    int j = 1;
+    for (int i = 1; i < learnt.size(); ++i) {
+        if (!reasons[learnt[i] >> 1] || !isRedundant(learnt[i]))
+            learnt[j++] = learnt[i];
+        else
+            dropped.append(learnt[i]);
+    }
+    learnt.resize(j);
+    for (int i = 1; i < learnt.size(); ++i)
+        seen[learnt[i] >> 1] = false;
+    foreach (int l, dropped)
+        seen[l >> 1] = false;
+    dropped.clear();
+
+    backtrackLevel = 0;
+    if (learnt.size() > 1) {
+        int highest = 1;
+        for (int i = 2; i < learnt.size(); ++i) {
+            if (levels[learnt[i] >> 1] > levels[learnt[highest] >> 1])
+                highest = i;
+        }
+        qSwap(learnt[1], learnt[highest]);
+        backtrackLevel = levels[learnt[1] >> 1];
+    }
+}
+
+/* A literal is redundant when all the other literals of its reason are already in the learnt clause: */
+bool SatSolver::isRedundant(int literal) const
+{
+    SatClause *reason = reasons[literal >> 1];
+    for (int k = 1; k < reason->size; ++k) {
+        int v = reason->literals[k] >> 1;
+        if (!seen[v] && levels[v])
+            return false;
+    }
+    return true;
+}
+
+void SatSolver::backtrack(int level)
+{
+    if (decisionLevel() <= level)
+        return;
+    for (int i = trail.size(); i-- > trailLimits[level];) {
+        int l = trail[i], v = l >> 1;
+        values[l] = values[l ^ 1] = 0;
+        reasons[v] = NULL;
+        phases[v] = (l & 1);
+        if (heapIndexes[v] < 0)
+            heapInsert(v);
+    }
+    trail.resize(trailLimits[level]);
+    trailLimits.resize(level);
+    propagationHead = trail.size();
+}
+
+int SatSolver::pickBranchLiteral()
+{
+    while (!heap.isEmpty()) {
+        int v = heapPop();
+        if (!values[2 * v])
+            return SatSolver::literal(v, phases[v]);
+    }
+    return -1;
+}
+
+void SatSolver::bumpVariable(int variable)
+{
+    if ((activity[variable] += variableIncrement) > 1e100) {
+        for (int v = 0; v < activity.size(); ++v)
+            activity[v] *= 1e-100;
+        variableIncrement *= 1e-100;
+    }
+    if (heapIndexes[variable] >= 0)
+        heapUp(heapIndexes[variable]);
+}
+
+void SatSolver::bumpClause(SatClause *clause)
+{
+    if ((clause->activity += clauseIncrement) > 1e20) {
+        foreach (SatClause *learnt, learnts)
+            learnt->activity *= 1e-20;
+        clauseIncrement *= 1e-20;
+    }
+}
+
+/* Removes the less active half of the learnt clauses that are not the reason of an assignment: */
+void SatSolver::reduceLearnts()
+{
+    qSort(learnts.begin(), learnts.end(), lessUseful);
+    QSet<SatClause *> removed;
+    int j = 0;
+    for (int i = 0; i < learnts.size(); ++i) {
+        SatClause *clause = learnts[i];
+        int v = clause->literals[0] >> 1;
+        bool locked = (reasons[v] == clause) && (value(clause->literals[0]) > 0);
+        if ((i < learnts.size() / 2) && (clause->size > 2) && !locked)
+            removed.insert(clause);
+        else
+            learnts[j++] = clause;
+    }
+    learnts.resize(j);
+    if (removed.isEmpty())
+        return;
+    for (int l = 0; l < watches.size(); ++l) {
+        QVector<Watcher> &ws = watches[l];
+        int k = 0;
+        for (int i = 0; i < ws.size(); ++i) {
+            if (!removed.contains(ws[i].clause))
+                ws[k++] = ws[i];
+        }
+        ws.resize(k);
+    }
+    foreach (SatClause *clause, removed)
+        deleteClause(clause);
+}
+
+SatSolver::Result SatSolver::solve(qint64 conflictBudget)
+{
+    model.clear();
+    if (!ok)
+        return Unsatisfiable;
+    backtrack(0);
+    if (propagate())
+        return Unsatisfiable;
+    if (maxLearnts <= 0)
+        maxLearnts = qMax(clauses.size() / 3.0, 1000.0);
+    QVector<int> learnt;
+    qint64 conflictsAtStart = stats.conflicts;
+    for (int restart = 0;; ++restart) {
+        qint64 restartBudget = qint64(luby(restart) * RESTART_BASE);
+        for (qint64 conflicts = 0;;) {
+            SatClause *conflict = propagate();
+            if (conflict) {
+                ++stats.conflicts;
+                ++conflicts;
+                if (!decisionLevel())
+                    return Unsatisfiable;
+                int backtrackLevel;
+                analyze(conflict, learnt, backtrackLevel);
+                backtrack(backtrackLevel);
+                if (learnt.size() == 1) {
+                    assign(learnt[0], NULL);
+                } else {
+                    SatClause *clause = newClause(learnt, true);
+                    learnts.append(clause);
+                    attach(clause);
+                    bumpClause(clause);
+                    assign(learnt[0], clause);
+                    ++stats.learnts;
+                }
+                variableIncrement /= VARIABLE_DECAY;
+                clauseIncrement /= CLAUSE_DECAY;
+                /* The learnt clauses allowed grow slower and slower: */
+                if (!--learntsAdjustCountdown) {
+                    learntsAdjustInterval *= LEARNTS_ADJUST_GROWTH;
+                    learntsAdjustCountdown = int(learntsAdjustInterval);
+                    maxLearnts *= LEARNTS_GROWTH;
+                }
+                continue;
+            }
+            if ((conflictBudget >= 0) && (stats.conflicts - conflictsAtStart >= conflictBudget)) {
+                backtrack(0);
+                return Unknown;
+            }
+            if (conflicts >= restartBudget)
+                break;
+            if (learnts.size() - trail.size() >= maxLearnts)
+                reduceLearnts();
+            int next = pickBranchLiteral();
+            if (next < 0) {
+                model.resize(getVariableCount());
+                for (int v = 0; v < getVariableCount(); ++v)
+                    model[v] = (values[2 * v] > 0);
+                backtrack(0);
+                return Satisfiable;
+            }
+            ++stats.decisions;
+            trailLimits.append(trail.size());
+            assign(next, NULL);
+        }
+        backtrack(0);
+        ++stats.restarts;
+    }
+}
+
+bool SatSolver::getValue(int variable) const
+{
+    return model.value(variable);
+}
+
+bool SatSolver::getLiteralValue(int literal) const
+{
+    return model.value(literal >> 1) != bool(literal & 1);
+}
+
+SatSolver::Stats SatSolver::getStats() const
+{
+    return stats;
+}
+
+/* Binary heap of the unassigned variables, most active first: */
+void SatSolver::heapInsert(int variable)
+{
+    heapIndexes[variable] = heap.size();
+    heap.append(variable);
+    heapUp(heap.size() - 1);
+}
+
+void SatSolver::heapUp(int position)
+{
+    int v = heap[position];
+    while (position > 0) {
+        int parent = (position - 1) >> 1;
+        if (activity[heap[parent]] >= activity[v])
+            break;
+        heap[position] = heap[parent];
+        heapIndexes[heap[position]] = position;
+        position = parent;
+    }
+    heap[position] = v;
+    heapIndexes[v] = position;
+}
+
+void SatSolver::heapDown(int position)
+{
+    int v = heap[position];
+    for (;;) {
+        int child = 2 * position + 1;
+        if (child >= heap.size())
+            break;
+        if ((child + 1 < heap.size()) && (activity[heap[child + 1]] > activity[heap[child]]))
+            ++child;
+        if (activity[heap[child]] <= activity[v])
+            break;
+        heap[position] = heap[child];
+        heapIndexes[heap[position]] = position;
+        position = child;
+    }
+    heap[position] = v;
+    heapIndexes[v] = position;
+}
+
+int SatSolver::heapPop()
+{
+    int v = heap.first();
+    heapIndexes[v] = -1;
+    int last = heap.takeLast();
+    if (!heap.isEmpty()) {
+        heap[0] = last;
+        heapIndexes[last] = 0;
+        heapDown(0);
+    }
+    return v;
+}
+
+TseitinEncoder::TseitinEncoder(SatSolver &solver) : solver(solver) {}
+
+int TseitinEncoder::encode(const Expression *e)
+{
+    /* Postorder without recursion, so that operands are encoded first: */
+    QVector<const Expression *> stack;
+    stack.append(e);
+    while (!stack.isEmpty()) {
+        const Expression *top = stack.last();
+        if (literals.contains(top)) {
+            stack.removeLast();
+            continue;
+        }
+        int pending = stack.size();
+        for (int i = top->getChildCount(); i-- > 0;) {
+            if (!literals.contains(top->getChild(i)))
+                stack.append(top->getChild(i));
+        }
+        if (stack.size() > pending)
+            continue;
+        stack.removeLast();
+        int x, a = -1, b = -1;
+        if (top->getChildCount() > 0)
+            a = literals.value(top->getChild(0));
+        if (top->getChildCount() > 1)
+            b = literals.value(top->getChild(1));
+        switch (top->getKind()) {
+        case Expression::Variable:
+        {
+            const QString &name = static_cast<const ExprVar *>(top)->getName();
+            if (!variables.contains(name))
+                variables.insert(name, solver.newVariable());
+            x = SatSolver::literal(variables.value(name));
+            break;
+        }
+        case Expression::NOT:
+            x = SatSolver::negate(a);
+            break;
+        case Expression::Imply:
+            a = SatSolver::negate(a);
+            /* a > b is ~a | b: */
+        case Expression::OR:
+            x = SatSolver::literal(solver.newVariable());
+            solver.addClause(QVector<int>() << SatSolver::negate(x) << a << b);
+            solver.addClause(QVector<int>() << x << SatSolver::negate(a));
+            solver.addClause(QVector<int>() << x << SatSolver::negate(b));
+            break;
+        case Expression::AND:
+            x = SatSolver::literal(solver.newVariable());
+            solver.addClause(QVector<int>() << x << SatSolver::negate(a) << SatSolver::negate(b));
+            solver.addClause(QVector<int>() << SatSolver::negate(x) << a);
+            solver.addClause(QVector<int>() << SatSolver::negate(x) << b);
+            break;
+        case Expression::Equiv:
+            x = SatSolver::literal(solver.newVariable());
+            solver.addClause(QVector<int>() << SatSolver::negate(x) << SatSolver::negate(a) << b);
+            solver.addClause(QVector<int>() << SatSolver::negate(x) << a << SatSolver::negate(b));
+            solver.addClause(QVector<int>() << x << a << b);
+            solver.addClause(QVector<int>() << x << SatSolver::negate(a) << SatSolver::negate(b));
+            break;
+        }
+        literals.insert(top, x);
+    }
+    return literals.value(e);
+}
+
+void TseitinEncoder::require(const Expression *e, bool value)
+{
+    /* Each conjunct is a disjunction of signed subformulas, gathered through the connectives that act as an OR: */
+    typedef QPair<const Expression *, bool> Signed;
+    QVector<Signed> conjuncts, disjuncts;
+    conjuncts.append(qMakePair(e, value));
+    while (!conjuncts.isEmpty()) {
+        disjuncts.append(conjuncts.takeLast());
+        QVector<int> clause;
+        while (!disjuncts.isEmpty()) {
+            Signed d = disjuncts.takeLast();
+            const Expression *a = d.first->getChild(0), *b = d.first->getChild(1);
+            bool alone = clause.isEmpty() && disjuncts.isEmpty();
+            switch (d.first->getKind()) {
+            case Expression::NOT:
+                disjuncts.append(qMakePair(a, !d.second));
+                continue;
+            case Expression::OR:
+                if (d.second) {
+                    disjuncts << qMakePair(a, true) << qMakePair(b, true);
+                    continue;
+                }
+                if (alone) {
+                    conjuncts << qMakePair(a, false) << qMakePair(b, false);
+                    continue;
+                }
+                break;
+            case Expression::AND:
+                if (!d.second) {
+                    disjuncts << qMakePair(a, false) << qMakePair(b, false);
+                    continue;
+                }
+                if (alone) {
+                    conjuncts << qMakePair(a, true) << qMakePair(b, true);
+                    continue;
+                }
+                break;
+            case Expression::Imply:
+                if (d.second) {
+                    disjuncts << qMakePair(a, false) << qMakePair(b, true);
+                    continue;
+                }
+                if (alone) {
+                    conjuncts << qMakePair(a, true) << qMakePair(b, false);
+                    continue;
+                }
+                break;
+            default:
+                break;
+            }
+            int l = encode(d.first);
+            clause.append(d.second ? l : SatSolver::negate(l));
+        }
+        if (!clause.isEmpty())
+            solver.addClause(clause);
+    }
+}
+
+int TseitinEncoder::getVariable(const QString &name) const
+{
+    return variables.value(name, -1);
+}
+
+QList<QString> TseitinEncoder::getVariableNames() const
+{
+    return variables.keys();
+}
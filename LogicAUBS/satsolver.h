@@ -0,0 +1,111 @@
+#ifndef SATSOLVER_H
+#define SATSOLVER_H
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+
+#include "proof.h"
+
+struct SatClause;
+
+/*
+ * CDCL SAT solver: two watched literals per clause, first-UIP clause learning
+ * with minimization, VSIDS decisions with phase saving, Luby restarts and
+ * periodic reduction of the learnt clauses.
+ * Variables are numbered from 0; the literal of variable v is 2 * v, and its
+ * negation 2 * v + 1.
+ */
+class SatSolver
+{
+public:
+    enum Result { Satisfiable, Unsatisfiable, Unknown };
+    struct Stats
+    {
+        qint64 decisions, propagations, conflicts, restarts, learnts;
+    };
+public:
+    SatSolver();
+    ~SatSolver();
+    int newVariable();
+    int getVariableCount() const;
+    bool addClause(QVector<int> literals);
+    Result solve(qint64 conflictBudget = -1);
+    bool getValue(int variable) const;
+    bool getLiteralValue(int literal) const;
+    Stats getStats() const;
+public:
+    static inline int literal(int variable, bool negated = false)
+    {
+        return 2 * variable + (negated ? 1 : 0);
+    }
+    static inline int negate(int literal)
+    {
+        return literal ^ 1;
+    }
+private:
+    struct Watcher
+    {
+        SatClause *clause;
+        int blocker;
+    };
+private:
+    inline int value(int literal) const;
+    int decisionLevel() const;
+    void assign(int literal, SatClause *reason);
+    SatClause *propagate();
+    void analyze(SatClause *conflict, QVector<int> &learnt, int &backtrackLevel);
+    bool isRedundant(int literal) const;
+    void backtrack(int level);
+    int pickBranchLiteral();
+    void attach(SatClause *clause);
+    void reduceLearnts();
+    void bumpVariable(int variable);
+    void bumpClause(SatClause *clause);
+    void heapInsert(int variable);
+    void heapUp(int position);
+    void heapDown(int position);
+    int heapPop();
+private:
+    bool ok;
+    QVector<SatClause *> clauses, learnts;
+    QVector< QVector<Watcher> > watches;
+    QVector<qint8> values;
+    QVector<int> levels;
+    QVector<SatClause *> reasons;
+    QVector<bool> phases;
+    QVector<int> trail, trailLimits;
+    int propagationHead;
+    QVector<double> activity;
+    double variableIncrement, clauseIncrement;
+    QVector<int> heap, heapIndexes;
+    QVector<bool> seen;
+    QVector<int> dropped;
+    QVector<bool> model;
+    double maxLearnts, learntsAdjustInterval;
+    int learntsAdjustCountdown;
+    Stats stats;
+};
+
+/*
+ * Tseitin encoding of expressions into a solver: every subformula gets a
+ * literal constrained to be equivalent to it. Shared subformulas are encoded
+ * once, and negations cost no variable. Formulas required to hold are split
+ * into clauses directly, without auxiliary variables for their outer
+ * connectives.
+ */
+class TseitinEncoder
+{
+public:
+    TseitinEncoder(SatSolver &solver);
+    int encode(const Expression *e);
+    void require(const Expression *e, bool value = true);
+    int getVariable(const QString &name) const;
+    QList<QString> getVariableNames() const;
+private:
+    SatSolver &solver;
+    QHash<const Expression *, int> literals;
+    QHash<QString, int> variables;
+};
+
+#endif // SATSOLVER_H
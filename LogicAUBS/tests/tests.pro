@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Unit tests of the proof model (make check)
+#
+#-------------------------------------------------
+
+QT       += core gui testlib
+
+TARGET = tst_proofmodel
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += tst_proofmodel.cpp \
+    ../proofmodel.cpp
+
+HEADERS += ../proofmodel.h
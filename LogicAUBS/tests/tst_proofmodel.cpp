@@ -0,0 +1,96 @@
+#include <QtTest>
+
+#include "proofmodel.h"
+
+Q_DECLARE_METATYPE(ProofEdit)
+
+class TestProofModel : public QObject
+{
+    Q_OBJECT
+private slots:
+    void editUnverifiedProof();
+    void replayEdits();
+};
+
+static Step makeStep(const QString &rule, const QList<int> &inputs, const QString &x, const QString &y,
+                     int clIndex, const QString &output)
+{
+    Step step;
+    step.rule = rule;
+    step.usedInputs = inputs;
+    if (!x.isEmpty())
+        step.renaming.insert("X", Expression::fromStr(x));
+    if (!y.isEmpty())
+        step.renaming.insert("Y", Expression::fromStr(y));
+    step.clIndex = clIndex;
+    step.output = Expression::fromStr(output);
+    step.indentation = 0;
+    return step;
+}
+
+/* Proof of X&Y : Y&X, loaded without being verified: */
+static Proof *unverifiedProof()
+{
+    QSharedPointer<Rule> rule(Rule::fromStr("X&Y : Y&X"));
+    QList<Step> steps;
+    steps.append(makeStep("-", QList<int>(), QString(), QString(), 0, "X&Y"));
+    steps.append(makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 1, "Y"));
+    steps.append(makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 0, "X"));
+    steps.append(makeStep(":IntroAnd", QList<int>() << 1 << 2, "Y", "X", 0, "Y&X"));
+    return new Proof(rule, steps, QList<int>() << 3, false);
+}
+
+void TestProofModel::editUnverifiedProof()
+{
+    ProofModel model;
+    model.setProof(unverifiedProof());
+    QVERIFY(!model.getProof()->isVerified());
+    QCOMPARE(model.rowCount(), 4);
+    /* The premises cannot be edited: */
+    QVERIFY(!model.replaceStep(0, makeStep("-", QList<int>(), QString(), QString(), 0, "Y&X")));
+    /* A new output, which the steps using it have to be checked against: */
+    QVERIFY(model.replaceStep(2, makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 0, "Y")));
+    QCOMPARE(model.data(model.index(2, ProofModel::FormulaColumn)).toString(), Expression::fromStr("Y")->getStr());
+    QVERIFY(model.insertStep(1, makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 0, "X")));
+    QCOMPARE(model.rowCount(), 5);
+    QCOMPARE(model.data(model.index(4, ProofModel::InputsColumn)).toString(), QString("3, 4"));
+    QVERIFY(model.removeStep(1));
+    QCOMPARE(model.rowCount(), 4);
+    QCOMPARE(model.data(model.index(3, ProofModel::InputsColumn)).toString(), QString("2, 3"));
+    /* The verdicts come from a verified copy: */
+    Proof verified(*model.getProof());
+    QVERIFY(verified.verify());
+    QVERIFY(!verified.isStepValid(2));
+    QVERIFY(!verified.isStepValid(3));
+    model.setVerdicts(verified);
+    QVERIFY(model.data(model.index(2, 0), Qt::BackgroundRole).isValid());
+    QVERIFY(!model.data(model.index(1, 0), Qt::BackgroundRole).isValid());
+    QVERIFY(!model.getProof()->isVerified());
+}
+
+/* The edits of the model, replayed on a verified copy, give the verdicts of a new verification: */
+void TestProofModel::replayEdits()
+{
+    qRegisterMetaType<ProofEdit>();
+    ProofModel model;
+    model.setProof(unverifiedProof());
+    QSignalSpy spy(&model, SIGNAL(edited(ProofEdit)));
+    QVERIFY(model.replaceStep(2, makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 0, "Y")));
+    QVERIFY(model.insertStep(3, makeStep(":ElimAnd", QList<int>() << 0, "X", "Y", 0, "X")));
+    QVERIFY(model.removeStep(1));
+    QCOMPARE(spy.count(), 3);
+    Proof *verified = unverifiedProof();
+    QVERIFY(verified->verify());
+    for (int i = 0; i < spy.count(); ++i)
+        verified->edit(spy.at(i).at(0).value<ProofEdit>());
+    Proof fresh(*model.getProof());
+    QVERIFY(fresh.verify());
+    QCOMPARE(verified->getStepCount(), fresh.getStepCount());
+    for (int i = 0; i < fresh.getStepCount(); ++i)
+        QCOMPARE(verified->isStepValid(i), fresh.isStepValid(i));
+    delete verified;
+}
+
+QTEST_MAIN(TestProofModel)
+
+#include "tst_proofmodel.moc"
@@ -0,0 +1,68 @@
+#include "validity.h"
+
+#include "evaluator.h"
+#include "satsolver.h"
+
+static Validity::Result fromEvaluator(Evaluator::Result result)
+{
+    return (result == Evaluator::Holds) ? Validity::Holds : Validity::Fails;
+}
+
+Validity::Result Validity::entails(const Rule &rule, int conclusion, QMap<QString, bool> *counterexample,
+                                   qint64 conflictBudget)
+{
+    Rule single(rule.getPremises(), QList<const Expression *>() << rule.getConclusions().at(conclusion));
+    return isSound(single, NULL, counterexample, conflictBudget);
+}
+
+Validity::Result Validity::isSound(const Rule &rule, int *failing, QMap<QString, bool> *counterexample,
+                                   qint64 conflictBudget)
+{
+    if ((rule.getInputVariableSet() | rule.getOutputVariableSet()).count() <= maxTableVariables)
+        return fromEvaluator(Evaluator::isSound(rule, failing, counterexample));
+    return isSoundBySat(rule, failing, counterexample, conflictBudget);
+}
+
+Validity::Result Validity::isTautology(const Expression *e, QMap<QString, bool> *counterexample, qint64 conflictBudget)
+{
+    return entails(Rule(QList<const Expression *>(), QList<const Expression *>() << e), 0, counterexample, conflictBudget);
+}
+
+/* The rule fails when its premises and the negation of one of its conclusions can all hold: */
+Validity::Result Validity::isSoundBySat(const Rule &rule, int *failing, QMap<QString, bool> *counterexample,
+                                        qint64 conflictBudget)
+{
+    SatSolver solver;
+    TseitinEncoder encoder(solver);
+    foreach (const Expression *premise, rule.getPremises())
+        encoder.require(premise);
+    QVector<int> conclusions, someFalse;
+    if (rule.getConclusions().size() == 1) {
+        encoder.require(rule.getConclusions().first(), false);
+    } else {
+        foreach (const Expression *conclusion, rule.getConclusions()) {
+            conclusions.append(encoder.encode(conclusion));
+            someFalse.append(SatSolver::negate(conclusions.last()));
+        }
+        solver.addClause(someFalse);
+    }
+    switch (solver.solve(conflictBudget)) {
+    case SatSolver::Unsatisfiable:
+        return Holds;
+    case SatSolver::Unknown:
+        return Unknown;
+    case SatSolver::Satisfiable:
+        break;
+    }
+    if (failing) {
+        *failing = 0;
+        while ((*failing < conclusions.size()) && solver.getLiteralValue(conclusions[*failing]))
+            ++*failing;
+    }
+    if (counterexample) {
+        counterexample->clear();
+        foreach (const QString &name, encoder.getVariableNames())
+            counterexample->insert(name, solver.getValue(encoder.getVariable(name)));
+    }
+    return Fails;
+}
@@ -0,0 +1,30 @@
+#ifndef VALIDITY_H
+#define VALIDITY_H
+
+#include <QString>
+#include <QMap>
+
+#include "proof.h"
+
+/*
+ * Semantic validity of rules and formulas, whatever their size: truth tables
+ * (see Evaluator) while there are few variables, the CDCL solver (see
+ * SatSolver) beyond. Unknown is only returned when the conflict budget of the
+ * solver runs out; a negative budget means no limit.
+ */
+class Validity
+{
+public:
+    enum Result { Holds, Fails, Unknown };
+    static const int maxTableVariables = 12;
+public:
+    static Result entails(const Rule &rule, int conclusion, QMap<QString, bool> *counterexample = NULL,
+                          qint64 conflictBudget = -1);
+    static Result isSound(const Rule &rule, int *failing = NULL, QMap<QString, bool> *counterexample = NULL,
+                          qint64 conflictBudget = -1);
+    static Result isTautology(const Expression *e, QMap<QString, bool> *counterexample = NULL, qint64 conflictBudget = -1);
+    static Result isSoundBySat(const Rule &rule, int *failing = NULL, QMap<QString, bool> *counterexample = NULL,
+                               qint64 conflictBudget = -1);
+};
+
+#endif // VALIDITY_H
@@ -0,0 +1,126 @@
+#include "verificationpool.h"
+#include "lemmacache.h"
+
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMetaObject>
+
+/* Runs on a worker thread, and reports to the pool through queued calls: */
+class VerificationJob : public QRunnable, public VerificationObserver
+{
+public:
+    VerificationJob(VerificationPool *pool, const QString &filename, Proof *proof, const QList<ProofEdit> &edits)
+        : pool(pool), id(-1), filename(filename), proof(proof), edits(edits), done(false)
+    {
+        setAutoDelete(false);
+    }
+    ~VerificationJob()
+    {
+        delete proof;
+    }
+    void run()
+    {
+        if (!cancelled.load()) {
+            /* The lemmas may have changed since the previous verification: */
+            LemmaCache::refresh();
+            if (!proof) {
+                proof = new Proof(filename, false);
+                proof->verify(this);
+            } else {
+                /* The progress counts the edits: */
+                for (int i = 0; (i < edits.size()) && stepsChecked(i, edits.size()); ++i)
+                    proof->edit(edits[i]);
+                stepsChecked(edits.size(), edits.size());
+            }
+        }
+        QMetaObject::invokeMethod(pool, "jobFinished", Qt::QueuedConnection, Q_ARG(int, id));
+    }
+    bool stepsChecked(int checked, int total)
+    {
+        if (cancelled.load())
+            return false;
+        QMetaObject::invokeMethod(pool, "jobProgress", Qt::QueuedConnection, Q_ARG(int, id), Q_ARG(int, checked), Q_ARG(int, total));
+        return true;
+    }
+public:
+    VerificationPool *pool;
+    int id;
+    QString filename;
+    Proof *proof;
+    QList<ProofEdit> edits;
+    QAtomicInt cancelled;
+    /* Set on the thread of the pool once the job has run: */
+    bool done;
+};
+
+VerificationPool::VerificationPool(QObject *parent) : QObject(parent), nextJob(0) {}
+
+VerificationPool::~VerificationPool()
+{
+    cancelAll();
+    qDeleteAll(jobs);
+}
+
+int VerificationPool::open(const QString &filename)
+{
+    return start(new VerificationJob(this, filename, NULL, QList<ProofEdit>()));
+}
+
+/* Each edit verifies again the steps it affects, with the incremental edition functions of the proof: */
+int VerificationPool::edit(Proof *proof, const QList<ProofEdit> &edits)
+{
+    return start(new VerificationJob(this, QString(), proof, edits));
+}
+
+int VerificationPool::start(VerificationJob *job)
+{
+    job->id = nextJob++;
+    jobs.insert(job->id, job);
+    threads.start(job);
+    return job->id;
+}
+
+void VerificationPool::cancel(int job)
+{
+    VerificationJob *j = jobs.value(job, NULL);
+    if (j)
+        j->cancelled.store(1);
+}
+
+void VerificationPool::cancelAll()
+{
+    foreach (VerificationJob *job, jobs)
+        job->cancelled.store(1);
+    threads.waitForDone();
+}
+
+/* Only valid from a slot connected to finished(), after which the job is deleted: */
+Proof *VerificationPool::takeResult(int job)
+{
+    VerificationJob *j = jobs.value(job, NULL);
+    if (!j || !j->done)
+        return NULL;
+    Proof *result = j->proof;
+    j->proof = NULL;
+    return result;
+}
+
+void VerificationPool::jobProgress(int job, int checked, int total)
+{
+    VerificationJob *j = jobs.value(job, NULL);
+    if (j && !j->cancelled.load())
+        emit progress(job, checked, total);
+}
+
+void VerificationPool::jobFinished(int job)
+{
+    VerificationJob *j = jobs.value(job, NULL);
+    if (!j)
+        return;
+    if (!j->cancelled.load()) {
+        j->done = true;
+        emit finished(job);
+    }
+    jobs.remove(job);
+    delete j;
+}
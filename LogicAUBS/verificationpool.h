@@ -0,0 +1,50 @@
+#ifndef VERIFICATIONPOOL_H
+#define VERIFICATIONPOOL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QHash>
+#include <QList>
+
+#include "proof.h"
+
+class VerificationJob;
+
+/*
+ * Worker threads shared by the proof windows, which load and verify proofs
+ * away from the GUI thread, and verify again only what edits affected. Jobs
+ * report their progress and their end through signals delivered on the thread
+ * of the pool; the proof they produced is then taken with takeResult(). A
+ * cancelled job stops at its next progress report, and nothing is signalled
+ * for it any more.
+ */
+class VerificationPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VerificationPool(QObject *parent = 0);
+    ~VerificationPool();
+    /* Loads and verifies a proof file, and returns the identifier of the job: */
+    int open(const QString &filename);
+    /* Applies the edits to a verified proof, which the pool owns until the result is taken: */
+    int edit(Proof *proof, const QList<ProofEdit> &edits);
+    void cancel(int job);
+    /* Cancels all the jobs, and waits for the threads to stop: */
+    void cancelAll();
+    /* Proof of a finished job, which the caller then owns; NULL once taken: */
+    Proof *takeResult(int job);
+signals:
+    void progress(int job, int checked, int total);
+    void finished(int job);
+private slots:
+    void jobProgress(int job, int checked, int total);
+    void jobFinished(int job);
+private:
+    int start(VerificationJob *job);
+private:
+    QThreadPool threads;
+    QHash<int, VerificationJob *> jobs;
+    int nextJob;
+};
+
+#endif // VERIFICATIONPOOL_H
@@ -0,0 +1,315 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QAtomicInt>
+#include <QThread>
+#include <QHash>
+#include <QVector>
+
+#include <cstdio>
+
+#include "proof.h"
+#include "lemmacache.h"
+#include "workstealingpool.h"
+
+#if defined(Q_OS_UNIX)
+#include <time.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+/* Exit codes: */
+#define EXIT_VERIFIED 0
+#define EXIT_FAILED 1
+#define EXIT_USAGE 2
+
+struct ProofNode
+{
+    QString path;
+    bool requested;
+    QStringList lemmas;
+    QList<int> dependencies, dependents;
+    QAtomicInt pending;
+    LemmaCache::Lemma result;
+    qint64 wallNsecs, cpuNsecs;
+};
+
+static qint64 threadCpuNsecs()
+{
+#if defined(Q_OS_UNIX)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#elif defined(Q_OS_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    quint64 k = (quint64(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    quint64 u = (quint64(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return qint64(k + u) * 100;
+#else
+    return 0;
+#endif
+}
+
+static const char *statusName(LemmaCache::Status status)
+{
+    switch (status) {
+    case LemmaCache::Verified:
+        return "verified";
+    case LemmaCache::NotFound:
+        return "not-found";
+    case LemmaCache::Incorrect:
+        return "incorrect";
+    case LemmaCache::Unfinished:
+        return "unfinished";
+    case LemmaCache::Cyclic:
+        return "cyclic";
+    }
+    return "unknown";
+}
+
+class ScanRunner : public TaskRunner
+{
+public:
+    ScanRunner(QList<ProofNode *> &nodes, int offset) : nodes(nodes), offset(offset) {}
+    void runTask(int task, int)
+    {
+        ProofNode *node = nodes[offset + task];
+        if (!LemmaCache::getDependencies(node->path, node->lemmas))
+            node->lemmas = Proof::scanLemmas(node->path);
+    }
+private:
+    QList<ProofNode *> &nodes;
+    int offset;
+};
+
+class VerifyRunner : public TaskRunner
+{
+public:
+    VerifyRunner(QList<ProofNode *> &nodes) : nodes(nodes), pool(NULL) {}
+    void setPool(WorkStealingPool *p)
+    {
+        pool = p;
+    }
+    void runTask(int task, int worker)
+    {
+        ProofNode *node = nodes[task];
+        QElapsedTimer timer;
+        timer.start();
+        qint64 cpuStart = threadCpuNsecs();
+        node->result = LemmaCache::get(node->path);
+        node->cpuNsecs = threadCpuNsecs() - cpuStart;
+        node->wallNsecs = timer.nsecsElapsed();
+        foreach (int dependent, node->dependents) {
+            if (!nodes[dependent]->pending.deref())
+                pool->push(dependent, worker);
+        }
+    }
+private:
+    QList<ProofNode *> &nodes;
+    WorkStealingPool *pool;
+};
+
+static void addNode(QList<ProofNode *> &nodes, QHash<QString, int> &index, const QString &path, bool requested)
+{
+    QHash<QString, int>::const_iterator it = index.constFind(path);
+    if (it != index.constEnd()) {
+        nodes[it.value()]->requested |= requested;
+        return;
+    }
+    ProofNode *node = new ProofNode;
+    node->path = path;
+    node->requested = requested;
+    node->wallNsecs = node->cpuNsecs = 0;
+    index.insert(path, nodes.size());
+    nodes.append(node);
+}
+
+static void printJson(const QJsonObject &object)
+{
+    QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    fwrite(line.constData(), 1, line.size(), stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("aubs-verify");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Verifies .aubs proofs and prints one JSON object per proof.");
+    parser.addHelpOption();
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of worker threads.", "n");
+    QCommandLineOption cacheOption("cache", "Verification cache file to load and update.", "file");
+    QCommandLineOption profileOption("profile", "Verify the requested proofs one by one first, and print their profile "
+                                     "with the n slowest steps and lemmas to stderr (needs CONFIG+=proof_profile).", "n");
+    parser.addOption(jobsOption);
+    parser.addOption(cacheOption);
+    parser.addOption(profileOption);
+    parser.addPositionalArgument("paths", "Proof files or directories to search for *.aubs and *.aubsb files.", "paths...");
+    parser.process(app);
+    QStringList paths = parser.positionalArguments();
+    if (paths.isEmpty()) {
+        fprintf(stderr, "%s", parser.helpText().toLocal8Bit().constData());
+        return EXIT_USAGE;
+    }
+    int jobs = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption)) {
+        bool valid;
+        jobs = parser.value(jobsOption).toInt(&valid);
+        if (!valid || (jobs < 1)) {
+            fprintf(stderr, "Invalid number of jobs.\n");
+            return EXIT_USAGE;
+        }
+    }
+    int profileCount = 0;
+    if (parser.isSet(profileOption)) {
+        bool valid;
+        profileCount = parser.value(profileOption).toInt(&valid);
+        if (!valid || (profileCount < 0)) {
+            fprintf(stderr, "Invalid number of profile entries.\n");
+            return EXIT_USAGE;
+        }
+    }
+    QString cacheFile = parser.value(cacheOption);
+    if (!cacheFile.isEmpty())
+        LemmaCache::load(cacheFile);
+    QElapsedTimer total;
+    total.start();
+
+    /* Collect the requested proofs: */
+    QList<ProofNode *> nodes;
+    QHash<QString, int> index;
+    foreach (const QString &path, paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDirIterator it(path, QStringList() << "*.aubs" << "*.aubsb", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                addNode(nodes, index, QFileInfo(it.next()).canonicalFilePath(), true);
+        } else if (info.isFile()) {
+            addNode(nodes, index, info.canonicalFilePath(), true);
+        } else {
+            fprintf(stderr, "No such file or directory: %s\n", path.toLocal8Bit().constData());
+            return EXIT_USAGE;
+        }
+    }
+
+    /* Build the lemma dependency graph, scanning newly discovered lemmas in rounds: */
+    for (int scanned = 0; scanned < nodes.size();) {
+        int count = nodes.size() - scanned;
+        ScanRunner scanRunner(nodes, scanned);
+        WorkStealingPool scanPool(jobs, &scanRunner);
+        for (int i = 0; i < count; ++i)
+            scanPool.push(i);
+        scanPool.run(count);
+        int end = nodes.size();
+        for (int i = scanned; i < end; ++i) {
+            foreach (const QString &lemma, nodes[i]->lemmas) {
+                QString path = QFileInfo(lemma).canonicalFilePath();
+                if (path.isEmpty())
+                    continue;
+                addNode(nodes, index, path, false);
+                int dependency = index.value(path);
+                if (!nodes[i]->dependencies.contains(dependency))
+                    nodes[i]->dependencies.append(dependency);
+            }
+        }
+        scanned = end;
+    }
+    QVector<int> inDegree(nodes.size(), 0);
+    for (int i = 0; i < nodes.size(); ++i) {
+        foreach (int dependency, nodes[i]->dependencies)
+            nodes[dependency]->dependents.append(i);
+        inDegree[i] = nodes[i]->dependencies.size();
+    }
+
+    /* Proofs on or behind a lemma cycle are never released by their lemmas; start them right away: */
+    QVector<int> order;
+    order.reserve(nodes.size());
+    QVector<int> degree = inDegree;
+    for (int i = 0; i < nodes.size(); ++i) {
+        if (!degree[i])
+            order.append(i);
+    }
+    for (int i = 0; i < order.size(); ++i) {
+        foreach (int dependent, nodes[order[i]]->dependents) {
+            if (!--degree[dependent])
+                order.append(dependent);
+        }
+    }
+    QVector<bool> blocked(nodes.size(), true);
+    foreach (int i, order)
+        blocked[i] = false;
+    for (int i = 0; i < nodes.size(); ++i) {
+        QList<int> released;
+        foreach (int dependent, nodes[i]->dependents) {
+            if (!blocked[dependent])
+                released.append(dependent);
+        }
+        nodes[i]->dependents = released;
+    }
+
+    /* Profiled proofs are verified on this thread, and the lemmas they load first are loaded on their behalf: */
+    if (parser.isSet(profileOption)) {
+        foreach (ProofNode *node, nodes) {
+            if (!node->requested)
+                continue;
+            Proof proof(node->path);
+            fprintf(stderr, "Profile of %s:\n%s", node->path.toLocal8Bit().constData(),
+                    proof.getProfileReport(profileCount).toLocal8Bit().constData());
+        }
+    }
+
+    /* Verify in topological order: */
+    VerifyRunner verifyRunner(nodes);
+    WorkStealingPool verifyPool(jobs, &verifyRunner);
+    verifyRunner.setPool(&verifyPool);
+    for (int i = 0; i < nodes.size(); ++i) {
+        nodes[i]->pending.store(blocked[i] ? 0 : inDegree[i]);
+        if (blocked[i] || !inDegree[i])
+            verifyPool.push(i);
+    }
+    verifyPool.run(nodes.size());
+
+    int verified = 0, failed = 0;
+    foreach (ProofNode *node, nodes) {
+        if (!node->requested)
+            continue;
+        const LemmaCache::Lemma &result = node->result;
+        QJsonObject object;
+        object.insert("file", node->path);
+        object.insert("status", QString(statusName(result.status)));
+        object.insert("correct", (result.status == LemmaCache::Verified) || (result.status == LemmaCache::Unfinished));
+        object.insert("finished", result.status == LemmaCache::Verified);
+        if (!result.error.isEmpty())
+            object.insert("error", result.error);
+        object.insert("wall_ms", node->wallNsecs / 1e6);
+        object.insert("cpu_ms", node->cpuNsecs / 1e6);
+        printJson(object);
+        if (result.status == LemmaCache::Verified)
+            ++verified;
+        else
+            ++failed;
+    }
+    QJsonObject summary;
+    summary.insert("files", verified + failed);
+    summary.insert("verified", verified);
+    summary.insert("failed", failed);
+    summary.insert("threads", verifyPool.getThreadCount());
+    summary.insert("wall_ms", total.nsecsElapsed() / 1e6);
+    QJsonObject wrapper;
+    wrapper.insert("summary", summary);
+    printJson(wrapper);
+    fflush(stdout);
+
+    if (!cacheFile.isEmpty() && !LemmaCache::save(cacheFile))
+        fprintf(stderr, "Could not write the cache file %s.\n", cacheFile.toLocal8Bit().constData());
+    qDeleteAll(nodes);
+    return failed ? EXIT_FAILED : EXIT_VERIFIED;
+}
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Command-line batch verifier for .aubs proofs
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = aubs-verify
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../core.pri)
+
+SOURCES += main.cpp \
+    workstealingpool.cpp
+
+HEADERS += workstealingpool.h
@@ -0,0 +1,116 @@
+#include "workstealingpool.h"
+
+#include <QThread>
+
+class PoolThread : public QThread
+{
+public:
+    PoolThread(WorkStealingPool *pool, int worker) : pool(pool), worker(worker) {}
+protected:
+    void run()
+    {
+        pool->work(worker);
+    }
+private:
+    WorkStealingPool *pool;
+    int worker;
+};
+
+WorkStealingPool::WorkStealingPool(int threadCount, TaskRunner *runner) : runner(runner), queued(0), remaining(0), nextWorker(0)
+{
+    if (threadCount < 1)
+        threadCount = 1;
+    deques.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i)
+        deques.append(new Deque);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    qDeleteAll(deques);
+}
+
+int WorkStealingPool::getThreadCount() const
+{
+    return deques.size();
+}
+
+void WorkStealingPool::push(int task, int worker)
+{
+    if ((worker < 0) || (worker >= deques.size())) {
+        stateLock.lock();
+        worker = nextWorker++ % deques.size();
+        stateLock.unlock();
+    }
+    Deque *deque = deques[worker];
+    deque->lock.lock();
+    deque->tasks.append(task);
+    deque->lock.unlock();
+    stateLock.lock();
+    ++queued;
+    stateChanged.wakeOne();
+    stateLock.unlock();
+}
+
+void WorkStealingPool::run(int taskCount)
+{
+    stateLock.lock();
+    remaining = taskCount;
+    stateLock.unlock();
+    QList<PoolThread *> threads;
+    for (int i = 0; i < deques.size(); ++i) {
+        threads.append(new PoolThread(this, i));
+        threads.last()->start();
+    }
+    foreach (PoolThread *thread, threads)
+        thread->wait();
+    qDeleteAll(threads);
+}
+
+void WorkStealingPool::work(int worker)
+{
+    forever {
+        int task;
+        if (pop(worker, task)) {
+            stateLock.lock();
+            --queued;
+            stateLock.unlock();
+            runner->runTask(task, worker);
+            stateLock.lock();
+            if (!--remaining)
+                stateChanged.wakeAll();
+            stateLock.unlock();
+            continue;
+        }
+        stateLock.lock();
+        while (!queued && remaining)
+            stateChanged.wait(&stateLock);
+        bool done = !remaining;
+        stateLock.unlock();
+        if (done)
+            return;
+    }
+}
+
+bool WorkStealingPool::pop(int worker, int &task)
+{
+    Deque *own = deques[worker];
+    own->lock.lock();
+    if (!own->tasks.isEmpty()) {
+        task = own->tasks.takeLast();
+        own->lock.unlock();
+        return true;
+    }
+    own->lock.unlock();
+    for (int i = 1; i < deques.size(); ++i) {
+        Deque *victim = deques[(worker + i) % deques.size()];
+        victim->lock.lock();
+        if (!victim->tasks.isEmpty()) {
+            task = victim->tasks.takeFirst();
+            victim->lock.unlock();
+            return true;
+        }
+        victim->lock.unlock();
+    }
+    return false;
+}
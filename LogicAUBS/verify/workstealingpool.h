@@ -0,0 +1,46 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+
+class TaskRunner
+{
+public:
+    virtual ~TaskRunner() {}
+    virtual void runTask(int task, int worker) = 0;
+};
+
+/*
+ * Fixed set of worker threads, each with its own task deque. A worker takes
+ * the most recently pushed task of its own deque and, when it is empty,
+ * steals the oldest task of another worker. Tasks pushed while running a
+ * task go to the current worker, so dependent work stays on the same thread.
+ */
+class WorkStealingPool
+{
+public:
+    WorkStealingPool(int threadCount, TaskRunner *runner);
+    ~WorkStealingPool();
+    int getThreadCount() const;
+    void push(int task, int worker = -1);
+    void run(int taskCount);
+    void work(int worker);
+private:
+    bool pop(int worker, int &task);
+private:
+    struct Deque
+    {
+        QMutex lock;
+        QList<int> tasks;
+    };
+    TaskRunner *runner;
+    QVector<Deque *> deques;
+    QMutex stateLock;
+    QWaitCondition stateChanged;
+    int queued, remaining, nextWorker;
+};
+
+#endif // WORKSTEALINGPOOL_H